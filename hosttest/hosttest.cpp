@@ -0,0 +1,264 @@
+/*
+ * hosttest.cpp
+ * Host-side checks of the motion code: the planner and LaosMotion run against the step
+ * timeline of sim.cpp instead of the stepper interrupt. Build and run with "make".
+ */
+#include "global.h"
+#include "LaosMotion.h"
+#include "planner.h"
+#include "stepper.h"
+#include "LaosIO.h"
+#include "sim.h"
+
+extern GlobalConfig *cfg;
+
+static int checks = 0, failures = 0;
+#define CHECK(cond) check((cond), #cond, __FILE__, __LINE__)
+#define NEAR(a, b, tol) (fabs((a) - (b)) <= (tol))
+
+static void check(bool ok, const char *what, const char *file, int line) {
+  checks++;
+  if (ok) return;
+  failures++;
+  printf("%s:%d: FAILED: %s\n", file, line, what);
+}
+
+static LaosMotion *mot;
+
+// start from rest at (x, y) [um], with the planner set up from cfg
+static void restart(int x, int y) {
+  plan_init();
+  st_set_position(0, 0, 0, 0);
+  mot->reset();
+  mot->setPositionAbsolute(x, y, 0);
+  sim_clear();
+}
+
+// write a word as the job reader does: when ready, running the machine meanwhile
+static void put(int i) {
+  while (!mot->ready())
+    if (!mot->ready()) sim_run(10000);  // the first call may only move queued work on
+  mot->write(i);
+}
+
+static void put(const int *words, int n) {
+  for (int k = 0; k < n; k++) put(words[k]);
+}
+
+// the job is written: run it to the end
+static void finish() {
+  mot->endJob();
+  while (mot->queue()) sim_run_all();
+}
+
+// index of the n-th bitmap block in the log, -1 if none
+static int bitmapBlock(int n) {
+  for (int k = 0; k < sim_blocks; k++)
+    if ((sim_log[k].options & OPT_BITMAP) && (n-- == 0)) return k;
+  return -1;
+}
+
+static unsigned long jobTime() {
+  unsigned long t = 0;
+  for (int k = 0; k < sim_blocks; k++) t += sim_log[k].time_us;
+  return t;
+}
+
+// 64 pixel (64 mm) bitmap line from (10, 50) to (74, 50) at 100 mm/sec, pixels 8..15 and
+// 40..47 set (first) or 0..7 and 40..47 set
+static void bitmapLine(bool first) {
+  int words[] = {7, 100, 1000,                           // bitmap speed: 10% of x.speed
+                 9, 1, 64, first ? 0xFF : 0xFF00, 0xFF00,  // 1 bpp, 64 pixels
+                 0, 10000, 50000, 1, 74000, 50000};
+  put(words, sizeof(words) / sizeof(words[0]));
+  finish();
+}
+
+/**
+*** user-026: blank runs are skipped at travel speed, the runs are traced at bitmap speed
+**/
+static void testRasterSkip() {
+  cfg->rasterlead = 0;
+  cfg->rasterbidir = 0;
+  cfg->rapidspeed = 400;
+  cfg->rapidaccel = 3000;  // as x.accel: the travels are not slowed down by their ramps
+  cfg->rasterskip = 2000;
+  restart(0, 50000);
+  bitmapLine(false);
+  int a = bitmapBlock(0), b = bitmapBlock(1);
+  CHECK(a >= 0 && b >= 0 && bitmapBlock(2) < 0);
+  if (a < 0 || b < 0) return;
+  CHECK(sim_log[a].bitmap_ofs == 8 && sim_log[a].bitmap_len == 8);
+  CHECK(NEAR(sim_log[a].x0, 18, 0.01) && NEAR(sim_log[a].x1, 26, 0.01));
+  CHECK(sim_log[b].bitmap_ofs == 40 && sim_log[b].bitmap_len == 8);
+  CHECK(NEAR(sim_log[b].x0, 50, 0.01) && NEAR(sim_log[b].x1, 58, 0.01));
+  // the blank run in between is a faster move, that does not slow down the junctions
+  CHECK(b == a + 2 && sim_log[a + 1].type == AT_MOVE && !(sim_log[a + 1].options & OPT_BITMAP));
+  CHECK(sim_log[a + 1].nominal_speed > 100);
+  CHECK(NEAR(sim_log[b].entry_speed, 100, 1));
+  CHECK(NEAR(sim_log[a + 2].entry_speed, sim_log[a].nominal_speed, 1));
+  unsigned long skip = jobTime();
+
+  // travel speed below the bitmap speed: the blank runs are not slower than the runs
+  cfg->rapidspeed = 50;
+  restart(0, 50000);
+  bitmapLine(false);
+  b = bitmapBlock(1);
+  CHECK(b >= 1 && sim_log[b - 1].nominal_speed >= 99);
+  if (b >= 1) CHECK(NEAR(sim_log[b].entry_speed, 100, 1));
+  cfg->rapidspeed = 400;
+
+  // without skipping: one bitmap block over the whole line, at bitmap speed
+  cfg->rasterskip = 0;
+  restart(0, 50000);
+  bitmapLine(false);
+  a = bitmapBlock(0);
+  CHECK(a >= 0 && bitmapBlock(1) < 0);
+  if (a >= 0) CHECK(sim_log[a].bitmap_ofs == 0 && sim_log[a].bitmap_len == 64);
+  CHECK(skip < jobTime());
+
+  // a blank line is not traced
+  cfg->rasterskip = 2000;
+  restart(0, 50000);
+  int blank[] = {9, 1, 64, 0, 0, 1, 74000, 50000};
+  put(blank, sizeof(blank) / sizeof(blank[0]));
+  finish();
+  CHECK(bitmapBlock(0) < 0);
+}
+
+/**
+*** user-029: runs are traced 'lead' ahead of their pixels, the overscan of a bidirectional
+*** line is v^2/(2*a) plus the lead
+**/
+static void testRasterLead() {
+  cfg->rasterlead = 1000;  // 0.1 mm at 100 mm/sec
+  cfg->rasterbidir = 0;
+  cfg->rapidspeed = 400;
+  cfg->rasterskip = 2000;
+  restart(0, 50000);
+  bitmapLine(false);
+  int a = bitmapBlock(0), b = bitmapBlock(1);
+  CHECK(a >= 0 && b >= 0);
+  if (a < 0 || b < 0) return;
+  CHECK(NEAR(sim_log[a].x0, 17.9, 0.01) && NEAR(sim_log[a].x1, 25.9, 0.01));
+  CHECK(NEAR(sim_log[b].x0, 49.9, 0.01) && NEAR(sim_log[b].x1, 57.9, 0.01));
+
+  // bidirectional, from above the left end: forward, overscan at both ends
+  cfg->rasterbidir = 1;
+  cfg->rapidaccel = 2000;  // lower than x.accel
+  restart(40000, 100000);
+  bitmapLine(true);
+  float overscan = 100.0 * 100.0 / (2 * 2000) + 0.1;
+  a = bitmapBlock(0);
+  CHECK(a >= 1);
+  if (a < 1) return;
+  CHECK(NEAR(sim_log[a - 1].x0, 10 - overscan, 0.01) && NEAR(sim_log[a - 1].y0, 50, 0.01));
+  CHECK(NEAR(sim_log[a].x0, 9.9, 0.01));
+  CHECK(sim_log[a].entry_speed >= 99);  // at bitmap speed from the first pixel on
+  CHECK(NEAR(sim_log[sim_blocks - 1].x1, 74 + overscan, 0.01));
+  CHECK(NEAR(sim_log[sim_blocks - 1].nominal_speed, 100, 1));
+
+  // the next line starts from the right end, in reverse
+  sim_clear();
+  int words[] = {9, 1, 64, 0xFF, 0xFF00, 0, 10000, 51000, 1, 74000, 51000};
+  put(words, sizeof(words) / sizeof(words[0]));
+  finish();
+  a = bitmapBlock(0);
+  CHECK(a >= 1 && (sim_log[a].options & OPT_BITMAP_REV));
+  if (a < 1) return;
+  CHECK(NEAR(sim_log[a - 1].x0, 74 + overscan, 0.01));
+  CHECK(NEAR(sim_log[sim_blocks - 1].x1, 10 - overscan, 0.01));
+  cfg->rasterbidir = 0;
+  cfg->rasterlead = 0;
+}
+
+/**
+*** user-038: the queued time is the time of the queued blocks, and the queue running empty
+*** during a job is an underrun
+**/
+static void zigzag(int n, bool slow) {
+  for (int k = 0; k < n; k++) {
+    put(1);
+    put(10000 + 10000 * (k + 1));
+    put(k % 2 ? 50000 : 60000);
+    if (slow) {
+      mot->ready();  // the reader stalls: the queue runs empty
+      while (mot->queue()) sim_run_all();
+    }
+  }
+}
+
+static void testUnderruns() {
+  int speed[] = {7, 100, 5000};  // 50 mm/sec
+  restart(10000, 50000);
+  put(speed, 3);
+  zigzag(12, false);
+  mot->ready();
+  unsigned long queued = plan_queue_time_us();
+  CHECK(queued > 0);
+  sim_clear();
+  sim_run_all();
+  CHECK(NEAR((float)jobTime(), (float)queued, 10));
+  CHECK(plan_queue_time_us() == 0);
+  mot->endJob();
+  while (mot->queue()) sim_run_all();
+
+  // the reader keeps up
+  restart(10000, 50000);
+  put(speed, 3);
+  zigzag(40, false);
+  CHECK(mot->underruns() == 0);
+  finish();
+  CHECK(mot->underruns() == 0);  // running empty after the job is not an underrun
+  CHECK(plan_queue_time_us() == 0);
+
+  // the reader stalls after every line
+  restart(10000, 50000);
+  put(speed, 3);
+  zigzag(5, true);
+  CHECK(mot->underruns() >= 4);
+}
+
+/**
+*** user-042: ramps from rest to the nominal speed last a whole nr of ringing periods
+**/
+static void testRampVibration() {
+  CHECK(plan_ramp_vibration(0.2, 0.1, 0) < 0.01);
+  CHECK(NEAR(plan_ramp_vibration(0.15, 0.1, 0), 2, 0.01));
+  CHECK(plan_ramp_vibration(0.15, 0, 0) == 1);
+  CHECK(plan_ramp_vibration(0.2, 0.1, 10) < plan_ramp_vibration(0.15, 0.1, 10));
+
+  cfg->xrampfreq = 7;
+  cfg->xrampdamping = 0;
+  cfg->rapidspeed = 100;
+  cfg->rapidaccel = 500;  // 0.2 sec from rest: 1.4 periods
+  float period = 1.0 / 7;
+  restart(10000, 50000);
+  CHECK(plan_ramp_vibration(100.0 / 500, period, 0) > 0.5);
+  int words[] = {0, 110000, 50000};
+  put(words, 3);
+  finish();
+  CHECK(sim_blocks == 1);
+  if (sim_blocks != 1) return;
+  float t = sim_log[0].nominal_speed / sim_log[0].acceleration;
+  CHECK(NEAR(t / period, floor(t / period + 0.5), 0.001) && t >= period);
+  CHECK(plan_ramp_vibration(t, period, 0) < 0.01);
+  cfg->xrampfreq = 0;
+}
+
+int main() {
+  cfg = new GlobalConfig("../config/config.txt");
+  cfg->buffertime = 2000;
+  cfg->underrun = 0;
+  cfg->xaccel = 3000;  // bitmap lines reach their speed within 2 mm
+  io = new LaosIO();
+  mot = new LaosMotion();
+
+  testRasterSkip();
+  testRasterLead();
+  testUnderruns();
+  testRampVibration();
+
+  printf("%d checks, %d failed\n", checks, failures);
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,15 @@
+/*
+ * laosfilesystem.h
+ * Host stand-in for the SD card file system: files are opened on the host
+ */
+#ifndef _HOSTTEST_LAOSFILESYSTEM_H_
+#define _HOSTTEST_LAOSFILESYSTEM_H_
+
+#include <stdio.h>
+
+class LaosFileSystem {
+ public:
+  FILE *openfile(const char *name, const char *mode) { return fopen(name, mode); }
+};
+
+#endif
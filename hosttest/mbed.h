@@ -0,0 +1,67 @@
+/*
+ * mbed.h
+ * Host stand-ins for the parts of the mbed API used by the motion code, so it can be
+ * built and checked on the host (see hosttest.cpp). Outputs are plain variables and
+ * inputs read as 0, the timers do nothing.
+ */
+#ifndef _HOSTTEST_MBED_H_
+#define _HOSTTEST_MBED_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef enum {
+  p5 = 5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15, p16, p17, p18, p19, p20,
+  p21, p22, p23, p24, p25, p26, p27, p28, p29, p30, LED1, LED2, LED3, LED4, NC
+} PinName;
+typedef enum { PullUp, PullDown, PullNone } PinMode;
+
+class DigitalOut {
+ public:
+  DigitalOut(PinName) : m_Value(0) {}
+  DigitalOut(PinName, int value) : m_Value(value) {}
+  DigitalOut &operator=(int value) { m_Value = value; return *this; }
+  operator int() { return m_Value; }
+ private:
+  int m_Value;
+};
+
+class DigitalIn {
+ public:
+  DigitalIn(PinName) {}
+  void mode(PinMode) {}
+  int read() { return 0; }
+  operator int() { return 0; }
+};
+
+class PwmOut {
+ public:
+  PwmOut(PinName) {}
+  void period(float) {}
+  PwmOut &operator=(float) { return *this; }
+  operator float() { return 0; }
+};
+
+class Ticker {
+ public:
+  void attach(void (*)(void), float) {}
+  void attach_us(void (*)(void), unsigned int) {}
+  void detach() {}
+};
+
+class Timer {
+ public:
+  void start() {}
+  void stop() {}
+  void reset() {}
+  int read_ms() { return 0; }
+  int read_us() { return 0; }
+};
+
+inline void wait(float) {}
+inline void wait_us(int) {}
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * sim.cpp
+ * Host stand-in for the stepper module and the IO system, see sim.h
+ */
+#include "sim.h"
+#include "global.h"
+#include "config.h"
+#include "stepper.h"
+#include "LaosIO.h"
+#include "laosfilesystem.h"
+
+volatile int32_t actpos_x, actpos_y, actpos_z, actpos_e;
+tSimBlock sim_log[SIM_LOG];
+int sim_blocks = 0;
+static unsigned long sim_us = 0;
+static tHold hold = HOLD_NONE;
+
+LaosIO *io = NULL;
+LaosFileSystem sd;
+GlobalConfig *cfg = NULL;
+
+void sim_clear() {
+  sim_blocks = 0;
+}
+
+unsigned long sim_time() {
+  return sim_us;
+}
+
+// execute the current block: log it and move to its end
+static unsigned long sim_block() {
+  extern config_t config;
+  block_t *block = plan_get_current_block();
+  if (block == NULL) return 0;
+  tSimBlock *s = &sim_log[sim_blocks < SIM_LOG ? sim_blocks++ : SIM_LOG - 1];
+  s->type = block->action_type;
+  s->options = block->options;
+  s->x0 = actpos_x / config.steps_per_mm_x;
+  s->y0 = actpos_y / config.steps_per_mm_y;
+  actpos_x += (block->direction_bits & (1 << X_DIRECTION_BIT)) ? -(int32_t)block->steps_x : block->steps_x;
+  actpos_y += (block->direction_bits & (1 << Y_DIRECTION_BIT)) ? -(int32_t)block->steps_y : block->steps_y;
+  actpos_z += (block->direction_bits & (1 << Z_DIRECTION_BIT)) ? -(int32_t)block->steps_z : block->steps_z;
+  s->x1 = actpos_x / config.steps_per_mm_x;
+  s->y1 = actpos_y / config.steps_per_mm_y;
+  s->entry_speed = block->entry_speed / 60.0;
+  s->nominal_speed = block->nominal_speed / 60.0;
+  s->acceleration = block->acceleration;
+  s->time_us = block->time_us;
+  s->bitmap_ofs = block->bitmap_ofs;
+  s->bitmap_len = block->bitmap_len;
+  unsigned long us = block->time_us;
+  sim_us += us;
+  plan_discard_current_block();
+  return us;
+}
+
+unsigned long sim_run(unsigned long us) {
+  unsigned long t = 0;
+  while (t < us && !plan_queue_empty()) t += sim_block();
+  return t;
+}
+
+void sim_run_all() {
+  while (!plan_queue_empty()) sim_block();
+}
+
+// stepper module
+void st_init() { hold = HOLD_NONE; }
+void st_synchronize() { sim_run_all(); }
+void st_wake_up() {}
+void st_set_bitmap_bpp(int bpp) {}
+void st_set_power_override(int percent) {}
+uint32_t st_endstops_hit() { return 0; }
+void st_feed_hold() { hold = HOLD_STOPPED; }
+int st_resume() { hold = HOLD_NONE; return 1; }
+tHold st_hold_state() { return hold; }
+int st_abort() { plan_flush(); hold = HOLD_NONE; return 1; }
+int st_poll() { return 1; }
+int st_interlock_open() { return 0; }
+uint32_t st_interlock_latency() { return 0; }
+void exhaust_off() {}
+
+void st_get_status(tStStatus *status) {
+  memset(status, 0, sizeof(*status));
+  status->x = actpos_x;
+  status->y = actpos_y;
+  status->z = actpos_z;
+  status->e = actpos_e;
+}
+
+float st_status_speed(const tStStatus *status) { return 0; }
+
+void st_set_position(int32_t x, int32_t y, int32_t z, int32_t e) {
+  actpos_x = x;
+  actpos_y = y;
+  actpos_z = z;
+  actpos_e = e;
+}
+
+// IO system: the cover is closed
+LaosIO::LaosIO() {}
+LaosIO::~LaosIO() {}
+void LaosIO::set(int line, bool state) {}
+bool LaosIO::get(int line) { return line == IO_COVER; }
+void LaosIO::write(unsigned long mask, unsigned long value) {}
+unsigned long LaosIO::read() { return 1UL << IO_COVER; }
+bool LaosIO::edge(int line, unsigned long *time_us) { return false; }
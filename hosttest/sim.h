@@ -0,0 +1,31 @@
+/*
+ * sim.h
+ * Host stand-in for the stepper module: executes the queued blocks in simulated time,
+ * and logs every block as the stepper interrupt would pick it up.
+ */
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include "planner.h"
+
+// one executed block
+typedef struct {
+  eActionType type;
+  uint8_t options;
+  float x0, y0, x1, y1; // start and end position [mm]
+  float entry_speed, nominal_speed; // [mm/sec]
+  float acceleration; // [mm/sec2]
+  uint32_t time_us; // estimated time [usec]
+  uint16_t bitmap_ofs, bitmap_len;
+} tSimBlock;
+
+#define SIM_LOG 256
+extern tSimBlock sim_log[SIM_LOG];
+extern int sim_blocks; // nr of blocks in sim_log
+
+void sim_clear(); // clear the log
+unsigned long sim_run(unsigned long us); // execute whole blocks for at least us [usec], returns the time executed
+void sim_run_all(); // execute all queued blocks
+unsigned long sim_time(); // simulated time [usec]
+
+#endif
@@ -60,6 +60,15 @@ void LaosExtent::AddToBoundary(int x, int y) {
   m_HasMinMaxCoordinates = true;
 }
 
+// add the chord end points of a curve to the extent
+void LaosExtent::AddCurveToBoundary(LaosCurve *curve) {
+  float x, y;
+  AddToBoundary(m_TargetX, m_TargetY);
+  while (curve->next(&x, &y)) AddToBoundary((int)x, (int)y);
+  m_TargetX = m_CurveParam[(m_Command == 10) ? 0 : 4];
+  m_TargetY = m_CurveParam[(m_Command == 10) ? 1 : 5];
+}
+
 LaosExtent::TError LaosExtent::GetBoundary(int &minx, int &miny, int &maxx, int &maxy) const {
   minx = m_MinX;
   miny = m_MinY;
@@ -104,6 +113,10 @@ void LaosExtent::Write(int i) {
                // ignored
         if (m_Step == 1) m_Step = 0;
         break;
+      case 3:  // dwell
+               // ignored
+        if (m_Step == 2) m_Step = 0;
+        break;
       case 4:  // set x,y,z (absolute)
         // Not supported
         if (!m_Error) m_Error = errCoordReferenceChanged;
@@ -112,10 +125,36 @@ void LaosExtent::Write(int i) {
       case 5:  // nop
         m_Step = 0;
         break;
+      case 6:  // auxiliary outputs
+               // ignored
+        if (m_Step == 2) m_Step = 0;
+        break;
       case 7:  // set index,value
                // ignored
         if (m_Step == 2) m_Step = 0;
         break;
+      case 10:  // arc x,y around cx,cy (laser on): 10 <x> <y> <cx> <cy> <ccw>
+        m_CurveParam[m_Step - 1] = i;
+        if (m_Step == 5) {
+          LaosCurve curve;
+          extern GlobalConfig *cfg;
+          curve.arc(m_TargetX, m_TargetY, m_CurveParam[0], m_CurveParam[1], m_CurveParam[2], m_CurveParam[3],
+                    m_CurveParam[4] != 0, cfg->tolerance);
+          AddCurveToBoundary(&curve);
+          m_Step = 0;
+        }
+        break;
+      case 11:  // cubic bezier to x,y (laser on): 11 <x1> <y1> <x2> <y2> <x> <y>
+        m_CurveParam[m_Step - 1] = i;
+        if (m_Step == 6) {
+          LaosCurve curve;
+          extern GlobalConfig *cfg;
+          curve.cubic(m_TargetX, m_TargetY, m_CurveParam[0], m_CurveParam[1], m_CurveParam[2], m_CurveParam[3],
+                      m_CurveParam[4], m_CurveParam[5], cfg->tolerance);
+          AddCurveToBoundary(&curve);
+          m_Step = 0;
+        }
+        break;
       case 9:  // Store bitmap mark data format: 9 <bpp> <width> <data-0> <data-1> ... <data-n>
         if (m_Step == 1) {
           m_BitmapBpp = i;
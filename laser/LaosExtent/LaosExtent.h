@@ -4,6 +4,7 @@
 #include "global.h"
 #include "pins.h"
 #include "planner.h"
+#include "LaosCurve.h"
 
 // forward decls:
 class LaosMotion;
@@ -29,6 +30,7 @@ public:
 
 private:
 	void AddToBoundary(int x, int y);
+	void AddCurveToBoundary(LaosCurve *curve);
 
 private:
 	int m_MinX, m_MaxX, m_MinY, m_MaxY;  // boundaries (multiplied by 1000)
@@ -36,6 +38,7 @@ private:
 	int m_TargetX, m_TargetY;            // target pos of current command
 	int m_BitmapSize;
 	int m_BitmapBpp;
+	int m_CurveParam[6];                 // parameters of arc and bezier commands
 	int m_Step;
 	int m_Command;
 	bool m_OnlyMovesWithLaserOn;
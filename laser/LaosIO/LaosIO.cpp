@@ -21,30 +21,202 @@
  *
  * set and get inputs/outputs for the peripherals
  *
- @code 
+ @code
  --code--
  @endcode
  */
 
 #include "LaosIO.h"
 
+// GPIO port and bit of every line, see IO_* in LaosIO.h
+static const struct {
+  unsigned char port, bit;
+} s_Lines[IO_LINES] = {
+  {0, 8},   // IO_EXHAUST: p6 = P0.8
+  {0, 26},  // IO_AIR: p18 = P0.26
+  {1, 30},  // IO_COVER: p19 = P1.30
+  {0, 6},   // IO_XHOME: p8 = P0.6
+  {0, 25},  // IO_YHOME: p17 = P0.25
+  {0, 23},  // IO_ZMIN: p15 = P0.23
+  {0, 24},  // IO_ZMAX: p16 = P0.24
+};
+
+static LaosIO *s_IO = NULL; // the instance served by the GPIO interrupt
+
+static inline LPC_GPIO_TypeDef *gpioPort(int port)
+{
+  static LPC_GPIO_TypeDef *const ports[IO_PORTS] = {LPC_GPIO0, LPC_GPIO1, LPC_GPIO2, LPC_GPIO3, LPC_GPIO4};
+  return ports[port];
+}
+
+/**
+*** Configure the outputs (off) and the edge interrupts of the inputs on port 0 and 2,
+*** and start the debouncer. The pull-ups of the inputs are set by their DigitalIn (pins.cpp).
+**/
 LaosIO::LaosIO()
 {
-  state = 0;
+  extern GlobalConfig *cfg;
+  int i;
+  for (i = 0; i < IO_PORTS; i++)
+    m_OutMask[i] = m_InMask[i] = 0;
+  m_IrqLines = 0;
+  for (i = 0; i < IO_LINES; i++) {
+    if (IO_OUTPUTS & (1 << i))
+      m_OutMask[s_Lines[i].port] |= 1UL << s_Lines[i].bit;
+    else {
+      m_InMask[s_Lines[i].port] |= 1UL << s_Lines[i].bit;
+      if (s_Lines[i].port == 0 || s_Lines[i].port == 2)
+        m_IrqLines |= 1 << i;
+    }
+    m_Count[i] = 0;
+    m_EdgeTime[i] = 0;
+  }
+  for (i = 0; i < IO_PORTS; i++) {
+    if (m_OutMask[i]) {
+      gpioPort(i)->FIOCLR = m_OutMask[i];
+      gpioPort(i)->FIODIR |= m_OutMask[i];
+    }
+  }
+  m_Debounce = (cfg->debounce * 1000 + IO_SAMPLE_US - 1) / IO_SAMPLE_US;
+  if (m_Debounce < 1) m_Debounce = 1;
+  if (m_Debounce > 255) m_Debounce = 255;
+  m_State = read() & IO_INPUTS;
+  m_Edges = 0;
+
+  s_IO = this;
+  LPC_GPIOINT->IO0IntClr = m_InMask[0];
+  LPC_GPIOINT->IO2IntClr = m_InMask[2];
+  LPC_GPIOINT->IO0IntEnR |= m_InMask[0];
+  LPC_GPIOINT->IO0IntEnF |= m_InMask[0];
+  LPC_GPIOINT->IO2IntEnR |= m_InMask[2];
+  LPC_GPIOINT->IO2IntEnF |= m_InMask[2];
+  NVIC_SetVector(EINT3_IRQn, (uint32_t)&LaosIO::edgeIrq);
+  NVIC_EnableIRQ(EINT3_IRQn);
+  m_Ticker.attach_us(this, &LaosIO::sample, IO_SAMPLE_US);
 }
 
 LaosIO::~LaosIO()
 {
+  m_Ticker.detach();
+  NVIC_DisableIRQ(EINT3_IRQn);
+  s_IO = NULL;
 }
 
-
+/**
+*** set()
+*** Set an output line
+**/
 void LaosIO::set(int line, bool state)
 {
+  write(1UL << line, state ? 1UL << line : 0);
 }
 
+/**
+*** get()
+*** Debounced state of an input, actual state of an output
+**/
 bool LaosIO::get(int line)
 {
-  return false;
+  if (IO_OUTPUTS & (1 << line))
+    return (gpioPort(s_Lines[line].port)->FIOPIN >> s_Lines[line].bit) & 1;
+  return (m_State >> line) & 1;
+}
+
+/**
+*** write()
+*** Set the output lines in mask to value. The set and clear registers of a port only change
+*** the pins written with a one, so this is safe from interrupts, and does not disturb other
+*** pins of the port (like the stepper outputs).
+**/
+void LaosIO::write(unsigned long mask, unsigned long value)
+{
+  unsigned long set[IO_PORTS] = {0, 0, 0, 0, 0}, clr[IO_PORTS] = {0, 0, 0, 0, 0};
+  mask &= IO_OUTPUTS;
+  for (int i = 0; mask; i++, mask >>= 1) {
+    if (!(mask & 1)) continue;
+    if (value & (1UL << i))
+      set[s_Lines[i].port] |= 1UL << s_Lines[i].bit;
+    else
+      clr[s_Lines[i].port] |= 1UL << s_Lines[i].bit;
+  }
+  for (int p = 0; p < IO_PORTS; p++) {
+    if (set[p]) gpioPort(p)->FIOSET = set[p];
+    if (clr[p]) gpioPort(p)->FIOCLR = clr[p];
+  }
 }
 
+/**
+*** read()
+*** Actual state of all lines
+**/
+unsigned long LaosIO::read()
+{
+  unsigned long pins[IO_PORTS], result = 0;
+  for (int p = 0; p < IO_PORTS; p++)
+    pins[p] = (m_OutMask[p] | m_InMask[p]) ? gpioPort(p)->FIOPIN : 0;
+  for (int i = 0; i < IO_LINES; i++)
+    if (pins[s_Lines[i].port] & (1UL << s_Lines[i].bit)) result |= 1UL << i;
+  return result;
+}
+
+/**
+*** edge()
+*** Returns true if the input changed since the last call, with the time of the last change
+*** [usec]. Inputs on port 0 and 2 are timestamped by the GPIO interrupt, the others when the
+*** debounced state changes.
+**/
+bool LaosIO::edge(int line, unsigned long *time_us)
+{
+  bool result;
+  __disable_irq();
+  result = (m_Edges >> line) & 1;
+  m_Edges &= ~(1UL << line);
+  if (time_us != NULL) *time_us = m_EdgeTime[line];
+  __enable_irq();
+  return result;
+}
 
+/**
+*** sample()
+*** Timer interrupt: an input changes its debounced state after it differs for m_Debounce
+*** consecutive samples
+**/
+void LaosIO::sample()
+{
+  unsigned long diff = (read() ^ m_State) & IO_INPUTS;
+  for (int i = 0; i < IO_LINES; i++) {
+    if (!(diff & (1UL << i))) {
+      m_Count[i] = 0;
+      continue;
+    }
+    if (++m_Count[i] < m_Debounce) continue;
+    m_Count[i] = 0;
+    m_State ^= 1UL << i;
+    if (!(m_IrqLines & (1UL << i))) {
+      m_EdgeTime[i] = us_ticker_read();
+      m_Edges |= 1UL << i;
+    }
+  }
+}
+
+/**
+*** edgeIrq()
+*** GPIO interrupt: timestamp the edges of the inputs on port 0 and 2
+**/
+void LaosIO::edgeIrq()
+{
+  unsigned long t = us_ticker_read();
+  unsigned long edges0 = LPC_GPIOINT->IO0IntStatR | LPC_GPIOINT->IO0IntStatF;
+  unsigned long edges2 = LPC_GPIOINT->IO2IntStatR | LPC_GPIOINT->IO2IntStatF;
+  LPC_GPIOINT->IO0IntClr = edges0;
+  LPC_GPIOINT->IO2IntClr = edges2;
+  if (s_IO == NULL) return;
+  for (int i = 0; i < IO_LINES; i++) {
+    if (!(s_IO->m_IrqLines & (1UL << i))) continue;
+    unsigned long edges = (s_Lines[i].port == 0 ? edges0 : edges2);
+    if (edges & (1UL << s_Lines[i].bit)) {
+      s_IO->m_EdgeTime[i] = t;
+      s_IO->m_Edges |= 1UL << i;
+    }
+  }
+}
@@ -21,31 +21,70 @@
  *
  * set and get inputs/outputs for the peripherals
  *
- @code 
- --code--
- 
+ @code
+ LaosIO *io = new LaosIO();
+ io->write((1<<IO_EXHAUST)|(1<<IO_AIR), (1<<IO_EXHAUST)); // exhaust on, air assist off
+ if ( io->get(IO_COVER) ) ...                               // debounced input
+ unsigned long t;
+ if ( io->edge(IO_XHOME, &t) ) ...                          // the home switch changed at t [usec]
  @endcode
  */
 #ifndef _LAOSIO_H_
 #define _LAOSIO_H_
 #include "global.h"
 
+// IO lines: bit numbers in the masks of LaosIO
+#define IO_EXHAUST  0   // O3 (p6): exhaust
+#define IO_AIR      1   // p18: air assist
+#define IO_COVER    2   // p19: cover closed
+#define IO_XHOME    3   // p8: x home switch
+#define IO_YHOME    4   // p17: y home switch
+#define IO_ZMIN     5   // p15: z min switch
+#define IO_ZMAX     6   // p16: z max switch
+#define IO_LINES    7
+#define IO_OUTPUTS  ((1<<IO_EXHAUST)|(1<<IO_AIR))
+#define IO_INPUTS   (((1<<IO_LINES)-1) & ~IO_OUTPUTS)
+
+// nr of GPIO ports
+#define IO_PORTS 5
+// input sample period of the debouncer [usec]
+#define IO_SAMPLE_US 1000
+
     /** IO System
-      * Get and Set IO lines
+      * Get and Set IO lines. Outputs are written with one set and one clear
+      * register write per port, and can be written from interrupts. Inputs are
+      * debounced by a timer (sys.debounce). Edges of inputs on port 0 and 2 are
+      * captured by the GPIO interrupt, with a timestamp.
       */
 class LaosIO {
 public:
-    /** Make new LaosIO object. 
+    /** Make new LaosIO object.
       */
   LaosIO();
 
   ~LaosIO();
 
-  void set(int line, bool state);
-  bool get(int line);
+  void set(int line, bool state); // set an output line
+  bool get(int line); // debounced state of an input, actual state of an output
+  void write(unsigned long mask, unsigned long value); // set the output lines in mask to value
+  unsigned long read(); // actual state of all lines, one register read per port
+  unsigned long state() { return m_State; } // debounced state of all inputs
+  bool edge(int line, unsigned long *time_us); // true if the input changed since the last call, and when [usec]
 
 private:
-  unsigned int state;
+  void sample(); // debounce the inputs
+  static void edgeIrq(); // capture input edges
+
+  unsigned long m_OutMask[IO_PORTS], m_InMask[IO_PORTS]; // lines of every port
+  volatile unsigned long m_State;  // debounced inputs
+  unsigned char m_Count[IO_LINES]; // nr of samples an input differs from its debounced state
+  int m_Debounce;                  // nr of samples before a debounced input changes
+  volatile unsigned long m_Edges;  // inputs that changed since the last call to edge()
+  volatile unsigned long m_EdgeTime[IO_LINES]; // time of the last change [usec]
+  unsigned long m_IrqLines;        // inputs of which the edges are captured by the GPIO interrupt
+  Ticker m_Ticker;
 };
 
+extern LaosIO *io; // the IO system, made in main()
+
 #endif
@@ -113,15 +113,15 @@ static const char *screens[] = {
 
 #define HOMING (DELETE_OK + 1)
     "HOMING...       "
-    "                ",
+    "$$$$$$$$$$$$$$$$",
 
 #define ANALYZING (HOMING + 1)
     "ANALYZING...    "
     "                ",
 
 #define RUNNING (ANALYZING + 1)
-    "RUNNING...      "
-    "[cancel]        ",
+    "RUNNING F:210%  "
+    "[cancel] P:210% ",
 
 #define BUSY (RUNNING + 1)
     "BUSY: $$$$$$$$$$"
@@ -208,6 +208,14 @@ bool LaosMenu::Cancel() {
   return (c == K_CANCEL);
 }
 
+/***
+ *** check if ok is pressed
+ **/
+bool LaosMenu::Ok() {
+  int c = dsp->read();
+  return (c == K_OK);
+}
+
 /**
 *** Handle menu system
 *** Read keys, and plan next action on the screen, output screen if
@@ -250,6 +258,12 @@ void LaosMenu::Handle() {
     m_PrevKey = c;
   }
 
+  // homing started elsewhere (sys.autohome): show it until done
+  if (mot->isHoming() && (screen != HOMING)) {
+    lastscreen = MAIN;
+    screen = HOMING;
+  }
+
   if (c || screen != prevscreen || count > 9) {
     switch (screen) {
       case STARTUP:
@@ -630,21 +644,39 @@ void LaosMenu::Handle() {
                         args[0] = power[powerfield];
                         break;
         */
-      case HOMING:  // Homing screen
-        while (!mot->isStart())
-          ;
-        mot->home(cfg->xhome, cfg->yhome, cfg->zhome);
-        screen = lastscreen;
+      case HOMING:  // Homing screen: the main loop moves homing on
+        if (prevscreen != HOMING)
+          mot->startHoming(cfg->xhome, cfg->yhome, cfg->zhome);
+        else if (!mot->isHoming())
+          screen = lastscreen;
+        sarg = (char *)(mot->isStart() ? "" : "CLOSE THE COVER");
         break;
 
       case RUNNING:  // Screen while running
         switch (c) {
-          /* case K_CANCEL:
-              while (mot->queue());
-              mot->reset();
-              if (runfile != NULL) fclose(runfile);
-              runfile=NULL; screen=MAIN; menu=MAIN;
-              break; */
+          case K_CANCEL:  // feed hold: continue or abort on the PAUSE screen
+            mot->hold();
+            screen = PAUSE;
+            break;
+          // feed and power override of the running job
+          case K_UP:
+          case K_FUP:
+            mot->setFeedOverride(mot->feedOverride() + 10);
+            waitup = 1;
+            break;
+          case K_DOWN:
+          case K_FDOWN:
+            mot->setFeedOverride(mot->feedOverride() - 10);
+            waitup = 1;
+            break;
+          case K_RIGHT:
+            mot->setPowerOverride(mot->powerOverride() + 10);
+            waitup = 1;
+            break;
+          case K_LEFT:
+            mot->setPowerOverride(mot->powerOverride() - 10);
+            waitup = 1;
+            break;
           default:
             if (runfile == NULL) {
               runfile = sd.openfile(jobname, "rb");
@@ -660,26 +692,49 @@ void LaosMenu::Handle() {
                 mot->write(readint(runfile));
                 if (cfg->disablecancelcheck == false) {
                   if (dsp->read_nb() == K_CANCEL) {
-                    while (mot->queue())
-                      ;
-                    mot->reset();
-                    fseek(runfile, 0, SEEK_END);
+                    mot->hold();
+                    screen = PAUSE;
+                    break;
                   }
                 }
+                if (mot->interlockOpen()) {  // the cover opened: the job is held
+                  screen = PAUSE;
+                  break;
+                }
               }
 #ifdef READ_FILE_DEBUG
               printf("File parsed \n");
 #endif
-              if (feof(runfile) && mot->ready()) {
+              if (feof(runfile)) mot->endJob();  // the queue runs empty from here on
+              if ((screen == RUNNING) && feof(runfile) && mot->ready()) {
+                printf("Job done (underruns: %d, low buffer: %d, interlock: %d usec)\n", mot->underruns(),
+                       mot->lowBuffers(), mot->interlockLatency());
                 fclose(runfile);
                 runfile = NULL;
                 mot->moveToAbsolute(cfg->xrest, cfg->yrest, cfg->zrest);
                 screen = MAIN;
-              } else {
+              } else if (screen == RUNNING) {
                 nodisplay = 1;
               }
             }
         }
+        args[0] = mot->feedOverride();
+        args[1] = mot->powerOverride();
+        break;
+
+      case PAUSE:  // feed hold of the running job
+        switch (c) {
+          case K_OK:  // continue, once the cover is closed
+            if (mot->resume()) screen = RUNNING;
+            break;
+          case K_CANCEL:  // abort the job
+            mot->abort();  // then moves to the rest position
+            if (runfile != NULL) fclose(runfile);
+            runfile = NULL;
+            screen = MAIN;
+            break;
+        }
+        sarg = (mot->interlockOpen() ? (char *)"COVER OPEN" : jobname);
         break;
 
       case BOUNDARIES:
@@ -829,10 +884,8 @@ void LaosMenu::Handle() {
           case K_CANCEL: {
             enable = cfg->enable;
             // home the machine:
-            while (!mot->isStart())
-              ;
-            mot->home(cfg->xhome, cfg->yhome, cfg->zhome);
-            screen = MAIN;
+            screen = HOMING;
+            lastscreen = MAIN;
             m_LaserTestPower = 0;
             m_LaserTestTime = 0;
             waitup = 1;
@@ -63,6 +63,7 @@ public:
   void SetScreen(const std::string& msg);
   void SetFileName(char * name);
   bool Cancel();
+  bool Ok();
 
 private:
 
@@ -0,0 +1,131 @@
+/**
+ * LaosCurve.cpp
+ * Segment arcs and cubic Bezier curves into chords
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "LaosCurve.h"
+
+#include <math.h>
+
+#include "planner.h"
+#include "stepper.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+*** Clip a nr of chords to [1, CURVE_MAX_SEGMENTS]
+**/
+static int clipSegments(float n) {
+  if (!(n >= 1)) return 1;  // also catches NaN
+  if (n > CURVE_MAX_SEGMENTS) return CURVE_MAX_SEGMENTS;
+  return (int)ceil(n);
+}
+
+LaosCurve::LaosCurve() {
+  m_Segment = m_Segments = 0;
+}
+
+/**
+*** arc()
+*** The chord angle follows from the sagitta: a chord of angle a deviates r*(1-cos(a/2))
+*** from the arc. The end point of every chord is found by rotating the previous radius
+*** vector; every N_ARC_CORRECTION chords the position is recomputed exactly.
+**/
+void LaosCurve::arc(float x0, float y0, float x, float y, float cx, float cy, bool ccw, float tolerance) {
+  m_Type = curveArc;
+  m_CenterX = cx;
+  m_CenterY = cy;
+  m_EndX = x;
+  m_EndY = y;
+  m_Rx = x0 - cx;
+  m_Ry = y0 - cy;
+  m_Radius = sqrt(m_Rx * m_Rx + m_Ry * m_Ry);
+  m_Start = atan2(m_Ry, m_Rx);
+  float sweep = atan2(y - cy, x - cx) - m_Start;
+  if (ccw && (sweep <= 0)) sweep += 2 * M_PI;
+  if (!ccw && (sweep >= 0)) sweep -= 2 * M_PI;
+
+  float chord = M_PI / 2;  // max. chord angle
+  if (tolerance < m_Radius) {
+    float a = 2 * acos(1 - tolerance / m_Radius);
+    if (a < chord) chord = a;
+  }
+  m_Segments = clipSegments(fabs(sweep) / chord);
+  m_Segment = 0;
+  m_Step = sweep / m_Segments;
+  m_Cos = cos(m_Step);
+  m_Sin = sin(m_Step);
+}
+
+/**
+*** cubic()
+*** With n chords at equal steps of t, the deviation is at most |B''|max / (8 n^2),
+*** and |B''| <= 6 * max(|P0 - 2 P1 + P2|, |P1 - 2 P2 + P3|).
+**/
+void LaosCurve::cubic(float x0, float y0, float x1, float y1, float x2, float y2, float x, float y, float tolerance) {
+  m_Type = curveCubic;
+  m_Px[0] = x0; m_Py[0] = y0;
+  m_Px[1] = x1; m_Py[1] = y1;
+  m_Px[2] = x2; m_Py[2] = y2;
+  m_Px[3] = x;  m_Py[3] = y;
+  m_EndX = x;
+  m_EndY = y;
+
+  float ax = x0 - 2 * x1 + x2, ay = y0 - 2 * y1 + y2;
+  float bx = x1 - 2 * x2 + x, by = y1 - 2 * y2 + y;
+  float m = sqrt(ax * ax + ay * ay);
+  float mb = sqrt(bx * bx + by * by);
+  if (mb > m) m = mb;
+  m_Segments = (tolerance > 0) ? clipSegments(sqrt(0.75 * m / tolerance)) : CURVE_MAX_SEGMENTS;
+  m_Segment = 0;
+}
+
+/**
+*** next()
+*** Return the end point of the next chord. The last chord ends exactly at the end point.
+**/
+bool LaosCurve::next(float *x, float *y) {
+  if (done()) return false;
+  m_Segment++;
+  if (m_Segment == m_Segments) {
+    *x = m_EndX;
+    *y = m_EndY;
+    return true;
+  }
+  if (m_Type == curveArc) {
+    if (m_Segment % N_ARC_CORRECTION) {
+      float rx = m_Rx * m_Cos - m_Ry * m_Sin;
+      m_Ry = m_Rx * m_Sin + m_Ry * m_Cos;
+      m_Rx = rx;
+    } else {
+      float a = m_Start + m_Segment * m_Step;
+      m_Rx = m_Radius * cos(a);
+      m_Ry = m_Radius * sin(a);
+    }
+    *x = m_CenterX + m_Rx;
+    *y = m_CenterY + m_Ry;
+  } else {
+    float t = (float)m_Segment / m_Segments, s = 1 - t;
+    float b0 = s * s * s, b1 = 3 * s * s * t, b2 = 3 * s * t * t, b3 = t * t * t;
+    *x = b0 * m_Px[0] + b1 * m_Px[1] + b2 * m_Px[2] + b3 * m_Px[3];
+    *y = b0 * m_Py[0] + b1 * m_Py[1] + b2 * m_Py[2] + b3 * m_Py[3];
+  }
+  return true;
+}
@@ -0,0 +1,67 @@
+/**
+ * LaosCurve.h
+ * Segment arcs and cubic Bezier curves into chords
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef _LAOSCURVE_H_
+#define _LAOSCURVE_H_
+
+// upper limit of the nr of chords of one curve
+#define CURVE_MAX_SEGMENTS 4096
+
+    /** Incremental curve segmenter: returns the chord end points of an arc or
+      * cubic Bezier curve one at a time. The chords deviate at most 'tolerance'
+      * from the curve. Any unit can be used, as long as it is the same for
+      * coordinates and tolerance.
+      *
+      * Example:
+      * @code
+      * LaosCurve curve;
+      * float x, y;
+      * curve.arc(0, 0, 20, 0, 10, 0, true, 0.05);
+      * while (curve.next(&x, &y))
+      *   line_to(x, y);
+      * @endcode
+      */
+class LaosCurve {
+public:
+  LaosCurve();
+  // arc from (x0,y0) to (x,y) around center (cx,cy), counter clockwise if ccw is true.
+  // If start and end point coincide, a full circle is made.
+  void arc(float x0, float y0, float x, float y, float cx, float cy, bool ccw, float tolerance);
+  // cubic Bezier curve from (x0,y0) to (x,y), with control points (x1,y1) and (x2,y2)
+  void cubic(float x0, float y0, float x1, float y1, float x2, float y2, float x, float y, float tolerance);
+  bool next(float *x, float *y); // get the next chord end point, returns false if the curve is done
+  bool done() const { return m_Segment >= m_Segments; }
+  void stop() { m_Segment = m_Segments; } // abandon the rest of the curve
+
+private:
+  typedef enum {curveArc, curveCubic} TCurve;
+  TCurve m_Type;
+  int m_Segment, m_Segments;      // chords done, total nr of chords
+  float m_EndX, m_EndY;           // end point (exact)
+  // arc
+  float m_CenterX, m_CenterY, m_Radius;
+  float m_Start, m_Step;          // start angle and angle per chord [rad]
+  float m_Rx, m_Ry;               // radius vector of the last point
+  float m_Cos, m_Sin;             // rotation per chord
+  // cubic
+  float m_Px[4], m_Py[4];         // control points
+};
+
+#endif
@@ -28,15 +28,23 @@
 #include "pins.h"
 #include "planner.h"
 #include "stepper.h"
+#include "LaosIO.h"
 
 // #define DO_MOTION_TEST 1
 
+// homing: search distance of an axis without limits [mm]
+#define HOME_SEARCH 2000.0
+
 // globals
 unsigned int step = 0;
 int command = 0;
 int mark_speed = 100;    // 100 [mm/sec]
 int bitmap_speed = 100;  // 100 [mm/sec]
 int power = 10000;
+int pulse_spacing = 0;  // PPI: pulse spacing [micron], 0: laser on continuously
+int pulse_width = 100;  // PPI: pulse width [usec]
+int aux_mask = 0;       // auxiliary outputs (IO_* bits) set by the job, applied by every block
+int aux_value = 0;      // their state
 // next planner action to enqueue
 tActionRequest action;
 
@@ -53,6 +61,43 @@ unsigned long bitmap[BITMAP_SIZE];
 unsigned long bitmap_width = 0;  // nr of pixels
 unsigned long bitmap_size = 0;   // nr of bytes
 unsigned char bitmap_bpp = 1, bitmap_enable = 0;
+static unsigned char bitmap_bpp_next = 1;  // format of the next bitmap line, applied once the queue is empty
+static unsigned long bitmap_width_next = 0;
+
+/**
+*** Return the value of pixel i of the bitmap line (bitmap_bpp bits per pixel)
+**/
+static inline unsigned long bitmapPixel(unsigned long i) {
+  unsigned long bit = i * bitmap_bpp;
+  return (bitmap[bit / 32] >> (bit % 32)) & ((1UL << bitmap_bpp) - 1);
+}
+
+/**
+*** Return true if the bitmap line can be scanned per pixel (1, 2, 4 or 8 bpp)
+**/
+static inline bool bitmapValid() {
+  return (bitmap_width > 0) && (bitmap_bpp >= 1) && (bitmap_bpp <= 8) && ((32 % bitmap_bpp) == 0);
+}
+
+/**
+*** Find the first pixel of the bitmap line at or after traversal index k that is set
+*** (or blank, if set is false). Pixels are traversed from the last pixel to the first if
+*** reverse is true. Returns bitmap_width if there is none. Whole words are skipped at once.
+**/
+static unsigned long bitmapFind(unsigned long k, bool set, bool reverse) {
+  unsigned long ppw = 32 / bitmap_bpp;  // pixels per word
+  while (k < bitmap_width) {
+    unsigned long i = (reverse ? bitmap_width - 1 - k : k);
+    unsigned long word = bitmap[(i * bitmap_bpp) / 32];
+    if (word == (set ? 0UL : ~0UL)) {
+      k += (reverse ? (i % ppw) + 1 : ppw - (i % ppw));  // to the next word
+      continue;
+    }
+    if ((bitmapPixel(i) != 0) == set) return k;
+    k++;
+  }
+  return bitmap_width;
+}
 
 /**
 *** LaosMotion() Constructor
@@ -75,6 +120,8 @@ LaosMotion::LaosMotion() {
   xhome.mode(PullUp);
   yhome.mode(PullUp);
   isHome = false;
+  m_Home = HOME_IDLE;
+  m_Aborting = false;
   setOriginAbsolute(0, 0, 0);
   plan_init();
   st_init();
@@ -117,17 +164,36 @@ LaosMotion::~LaosMotion() {
 
 /**
 *** reset()
-*** reset the state
+*** reset the state. The planned position is where the queued motion ends (where the
+*** head is if the queue is empty): the first segment of the next job starts there.
 **/
 void LaosMotion::reset() {
   extern GlobalConfig *cfg;
+  float x, y, z;
 #ifdef READ_FILE_DEBUG
   printf("LaosMotion::reset()\n");
 #endif
   xstep = xdir = ystep = ydir = zstep = zdir = step = command = 0;
-  m_PlannedXAbsolute = 0;
-  m_PlannedYAbsolute = 0;
-  m_PlannedZAbsolute = 0;
+  plan_get_planned_position_xyz(&x, &y, &z);
+  m_PlannedXAbsolute = x * 1000;
+  m_PlannedYAbsolute = y * 1000;
+  m_PlannedZAbsolute = z * 1000;
+  m_MoveHeld = false;
+  m_FlushPath = false;
+  m_Curve.stop();
+  m_Wait = WAIT_NONE;
+  m_RasterOverscan = false;  // only bidirectional lines set it
+  plan_set_accel(cfg->accel);  // a raster line may have been abandoned
+  m_Feeding = m_Filled = m_Low = m_JobEnd = false;
+  m_Underruns = m_LowBuffers = 0;
+  plan_set_feed_scale(1.0);
+  setFeedOverride(100);
+  setPowerOverride(100);
+  m_Path.reset();
+  m_Path.setTolerance(cfg->mergetol / 1000.0);
+  m_Path.setBlend(cfg->blendtol / 1000.0);
+  pulse_spacing = 0;
+  aux_mask = aux_value = 0;
   *laser = LASEROFF;
   enable = cfg->enable;
   cover.mode(PullUp);
@@ -138,7 +204,28 @@ void LaosMotion::reset() {
 *** ready to receive new commands
 **/
 int LaosMotion::ready() {
-  return !plan_queue_full();
+  extern GlobalConfig *cfg;
+  poll();
+  if (isHoming() || m_Aborting) return 0;
+  if (!pump() || m_Path.full()) return 0;
+  // enough motion buffered: leave time for the network and user interface
+  return (cfg->buffertime <= 0) || (plan_queue_time_us() < 1000UL * cfg->buffertime);
+}
+
+/**
+*** bufferedTime()
+*** return the estimated time to execute the queued motion [usec]
+**/
+unsigned long LaosMotion::bufferedTime() {
+  return plan_queue_time_us();
+}
+
+/**
+*** freeSlots()
+*** return nr of blocks that can still be queued
+**/
+int LaosMotion::freeSlots() {
+  return plan_queue_free();
 }
 
 /**
@@ -146,7 +233,9 @@ int LaosMotion::ready() {
 *** return nr of items in the queue (0 is empty)
 **/
 int LaosMotion::queue() {
-  return plan_queue_items();
+  m_Path.flush();  // anyone waiting for the queue to empty also wants the held segment
+  bool done = pump();
+  return plan_queue_items() + m_Path.queued() + (done ? 0 : 1);
 }
 
 /**
@@ -174,6 +263,9 @@ void LaosMotion::moveToAbsoluteWithAbsoluteFeedrate(int x, int y, int z, int fee
   if (x > cfg->xmax) x = cfg->xmax;
   if (y > cfg->ymax) y = cfg->ymax;
   if (z > cfg->zmax) z = cfg->zmax;
+  // this does not wait: callers wait for ready() (or an empty queue), so m_Path has room
+  // for the held move and this one
+  flushHeldMove();
   tActionRequest action;
   action.target.x = x / 1000.0;
   action.target.y = y / 1000.0;
@@ -181,11 +273,104 @@ void LaosMotion::moveToAbsoluteWithAbsoluteFeedrate(int x, int y, int z, int fee
   action.ActionType = actiontype;
   action.target.feed_rate = feedrate;
   action.param = power;
-  plan_buffer_line(&action);
-  UpdatePlannedCoordinates(&action);
+  action.pulse_spacing = 0;
+  action.aux_mask = 0;
+  bufferLine(&action);
+  // not job data: nobody may call queue() to flush the held segment (e.g. the move to
+  // rest at the end of a job), so pump() passes it on to the planner as soon as it has room
+  m_FlushPath = true;
+  pump();
+  m_Feeding = false;  // the queue may run empty after this
   // printf("To buffer: %d, %d, %d, %d\n", x, y,z,speed);
 }
 
+/**
+*** endJob()
+*** All job data has been written: the queue runs empty from here on, which is neither an
+*** underrun nor a low buffer
+**/
+void LaosMotion::endJob() {
+  m_JobEnd = true;
+  m_Feeding = false;
+}
+
+/**
+*** hold(), resume(), isHeld()
+*** Feed hold: the laser power follows the speed while slowing down, and is off when stopped
+**/
+void LaosMotion::hold() {
+  st_feed_hold();
+}
+
+bool LaosMotion::resume() {
+  return st_resume();
+}
+
+bool LaosMotion::isHeld() {
+  return st_hold_state() == HOLD_STOPPED;
+}
+
+/**
+*** interlockOpen(), interlockLatency()
+*** Interlock: the cover is sampled every sys.interlock usec by the stepper module
+**/
+bool LaosMotion::interlockOpen() {
+  return st_interlock_open();
+}
+
+int LaosMotion::interlockLatency() {
+  return st_interlock_latency();
+}
+
+/**
+*** abort()
+*** Stop the running job as soon as possible, then move to the rest position from where
+*** the head stopped. This does not wait for the stop: poll() finishes it.
+**/
+void LaosMotion::abort() {
+  m_Aborting = true;
+  st_abort();
+  poll();
+}
+
+/**
+*** setFeedOverride()
+*** The override applies to the queued blocks after the current one, and to new blocks.
+*** Bitmap lines keep their speed, because the raster lead depends on it.
+**/
+void LaosMotion::setFeedOverride(int percent) {
+  if (percent < OVERRIDE_MIN) percent = OVERRIDE_MIN;
+  if (percent > OVERRIDE_MAX) percent = OVERRIDE_MAX;
+  m_FeedOverride = percent;
+  plan_set_feed_override(percent / 100.0);
+}
+
+/**
+*** setPowerOverride()
+*** The override is applied by the stepper interrupt, from the next step on.
+**/
+void LaosMotion::setPowerOverride(int percent) {
+  if (percent < OVERRIDE_MIN) percent = OVERRIDE_MIN;
+  if (percent > OVERRIDE_MAX) percent = OVERRIDE_MAX;
+  m_PowerOverride = percent;
+  st_set_power_override(percent);
+}
+
+/**
+*** bufferLine()
+*** Enqueue a move or line from the planned position to its target, through the
+*** segment merging stage. Returns false (and enqueues nothing) if m_Path is full: job
+*** data is only written when ready(), and the other producers check m_Path.full().
+**/
+bool LaosMotion::bufferLine(const tActionRequest *action) {
+  if (!m_Path.add(action, m_PlannedXAbsolute / 1000.0, m_PlannedYAbsolute / 1000.0, m_PlannedZAbsolute / 1000.0))
+    return false;
+  m_Path.pump();
+  m_Feeding = !m_JobEnd;
+  UpdatePlannedCoordinates(action);
+  return true;
+}
+
 void LaosMotion::UpdatePlannedCoordinates(const tActionRequest *action) {
   m_PlannedXAbsolute = action->target.x * 1000.0;
   m_PlannedYAbsolute = action->target.y * 1000.0;
@@ -200,6 +385,7 @@ void LaosMotion::UpdatePlannedCoordinates(const tActionRequest *action) {
 void LaosMotion::write(int i) {
   extern GlobalConfig *cfg;
   static int x = 0, y = 0, z = 0;
+  static int cp[6];  // curve parameters
   // if (  plan_queue_empty() )
   // printf("Empty\n");
 
@@ -207,9 +393,11 @@ void LaosMotion::write(int i) {
   printf(">%i (command: %i, step: %i)\n", i, command, step);
 #endif
 
+  m_FlushPath = false;  // job data: the held segment may still be merged
   if (step == 0) {
     command = i;
     step++;
+    if ((command != 9) && !((command == 1) && bitmap_enable)) flushHeldMove();
   } else {
     switch (command) {
       case 0:  // move x,y (laser off)
@@ -224,6 +412,10 @@ void LaosMotion::write(int i) {
             step = 0;
             action.target.z = 0;
             action.param = power;
+            action.pulse_spacing = pulse_spacing;
+            action.pulse_width = pulse_width;
+            action.aux_mask = aux_mask;
+            action.aux_value = aux_value;
             action.ActionType = (command ? AT_LASER : AT_MOVE);
             if (bitmap_enable && (action.ActionType == AT_LASER)) {
               action.ActionType = AT_BITMAP;
@@ -231,7 +423,7 @@ void LaosMotion::write(int i) {
             }
             switch (action.ActionType) {
               case AT_MOVE:
-                action.target.feed_rate = 60 * cfg->speed;
+                action.target.feed_rate = 60 * cfg->rapidspeed;
                 break;
               case AT_LASER:
                 action.target.feed_rate = 60 * mark_speed;
@@ -246,17 +438,16 @@ void LaosMotion::write(int i) {
             }
 
             if (action.ActionType == AT_BITMAP) {
-              while (queue())
-                ;  // printf("-"); // wait for queue to empty
-              plan_set_accel(cfg->xaccel);
-              plan_buffer_line(&action);
-              UpdatePlannedCoordinates(&action);
-              while (queue())
-                ;  // printf("*"); // wait for queue to empty
-              plan_set_accel(cfg->accel);
-            } else
-              plan_buffer_line(&action);
-            UpdatePlannedCoordinates(&action);
+              // trace the line once the queue is empty, at the raster acceleration
+              m_RasterLine = action;
+              m_Wait = WAIT_BITMAP_LINE;
+              pump();
+            } else if (cfg->rasterbidir && (action.ActionType == AT_MOVE)) {
+              m_HeldMove = action;  // may be the start of a bitmap line
+              m_MoveHeld = true;
+            } else {
+              bufferLine(&action);
+            }
             break;
         }
         break;
@@ -266,10 +457,29 @@ void LaosMotion::write(int i) {
             step = 0;
             z = action.target.z;
             action.param = power;
+            action.aux_mask = aux_mask;
+            action.aux_value = aux_value;
             action.ActionType = AT_MOVE;
             action.target.feed_rate = 60.0 * cfg->speed;
-            plan_buffer_line(&action);
-            UpdatePlannedCoordinates(&action);
+            bufferLine(&action);
+            break;
+        }
+        break;
+      case 3:  // dwell: 3 <time [msec]> <laser on (1) or off (0)>, e.g. a pierce delay
+        switch (step) {
+          case 1:
+            action.dwell_us = (i > 0 ? i : 0) * 1000UL;
+            break;
+          case 2:
+            step = 0;
+            action.ActionType = AT_WAIT;
+            action.target.x = m_PlannedXAbsolute / 1000.0;
+            action.target.y = m_PlannedYAbsolute / 1000.0;
+            action.target.z = m_PlannedZAbsolute / 1000.0;
+            action.param = (i ? power : 0);
+            action.aux_mask = aux_mask;
+            action.aux_value = aux_value;
+            bufferLine(&action);
             break;
         }
         break;
@@ -283,7 +493,7 @@ void LaosMotion::write(int i) {
             break;
           case 3:
             z = i;
-            setPositionRelativeToOrigin(x, y, z);
+            setPositionRelativeToOrigin(x, y, z);  // once the queue is empty
             step = 0;
             break;
         }
@@ -291,6 +501,39 @@ void LaosMotion::write(int i) {
       case 5:  // nop
         step = 0;
         break;
+      case 6:  // auxiliary outputs: 6 <mask> <value>, IO_* bits (1: exhaust, 2: air assist), from the next move on
+        switch (step) {
+          case 1:
+            param = i;
+            break;
+          case 2:
+            step = 0;
+            param &= IO_OUTPUTS;
+            aux_mask |= param;
+            aux_value = (aux_value & ~param) | (i & param);
+            break;
+        }
+        break;
+      case 10:  // arc x,y around cx,cy (laser on): 10 <x> <y> <cx> <cy> <ccw>
+        cp[step - 1] = i;
+        if (step == 5) {
+          step = 0;
+          m_Curve.arc(m_PlannedXAbsolute / 1000.0, m_PlannedYAbsolute / 1000.0, (cp[0] - ofsx) / 1000.0,
+                      (cp[1] - ofsy) / 1000.0, (cp[2] - ofsx) / 1000.0, (cp[3] - ofsy) / 1000.0, cp[4] != 0,
+                      cfg->tolerance / 1000.0);
+          startCurve();
+        }
+        break;
+      case 11:  // cubic bezier to x,y (laser on): 11 <x1> <y1> <x2> <y2> <x> <y>
+        cp[step - 1] = i;
+        if (step == 6) {
+          step = 0;
+          m_Curve.cubic(m_PlannedXAbsolute / 1000.0, m_PlannedYAbsolute / 1000.0, (cp[0] - ofsx) / 1000.0,
+                        (cp[1] - ofsy) / 1000.0, (cp[2] - ofsx) / 1000.0, (cp[3] - ofsy) / 1000.0,
+                        (cp[4] - ofsx) / 1000.0, (cp[5] - ofsy) / 1000.0, cfg->tolerance / 1000.0);
+          startCurve();
+        }
+        break;
       case 7:  // set index,value
         switch (step) {
           case 1:
@@ -315,24 +558,28 @@ void LaosMotion::write(int i) {
                 printf("> power: %i\n", power);
 #endif
                 break;
+              case 102:  // pulses per distance: pulse spacing [micron], 0 = off
+                if (val < 0) val = 0;
+                if (val > 65535) val = 65535;
+                pulse_spacing = val;
+                break;
+              case 103:  // pulses per distance: pulse width [usec]
+                if (val < 1) val = 1;
+                if (val > 65535) val = 65535;
+                pulse_width = val;
+                break;
             }
             break;
         }
         break;
       case 9:  // Store bitmap mark data format: 9 <bpp> <width> <data-0> <data-1> ... <data-n>
         if (step == 1) {
-          bitmap_bpp = i;
+          bitmap_bpp_next = i;  // 1, 2, 4 or 8: grayscale pixels set the laser power
         } else if (step == 2) {
-          //   if ( queue() ) printf("Queue not empty... wait...\n\r");
-          while (queue())
-            ;  // printf("+"); // wait for queue to empty
-          bitmap_width = i;
-          bitmap_enable = 1;
-          bitmap_size = (bitmap_bpp * bitmap_width) / 32;
-          if ((bitmap_bpp * bitmap_width) % 32)  // padd to next 32-bit
-            bitmap_size++;
-          // printf("\n\rBitmap: read %d dwords\n\r", bitmap_size);
-
+          // the bitmap buffer is in use until the queue is empty: store the data after that
+          bitmap_width_next = i;
+          m_Wait = WAIT_BITMAP_DATA;
+          pump();
         } else if (step > 2)  // copy data
         {
           bitmap[(step - 3) % BITMAP_SIZE] = i;
@@ -354,16 +601,322 @@ void LaosMotion::write(int i) {
   }
 }
 
+/**
+*** startBitmapLine()
+*** Start tracing a bitmap line that starts at (x0, y0) (the first pixel) and ends at the
+*** target of the line; the runs are enqueued by traceBitmapLine(). If reverse is true,
+*** the line is traced from its target back to (x0, y0). Only the runs that contain set
+*** pixels are traced at bitmap speed. Blank runs of at least cfg->rasterskip [um]
+*** (including the leading and trailing margin) become laser-off moves at travel speed,
+*** but not slower than the bitmap speed: the junctions with the runs stay at bitmap speed.
+*** The laser is re-synchronized to the bitmap at the first pixel of the next run. A line
+*** without any set pixels is skipped entirely.
+*** Every run is traced cfg->rasterlead [usec] ahead of its pixels, so the laser switches
+*** at the pixel edges despite its response time. The head travels back to start a run
+*** 'lead' before its first pixel (e.g. at the start of a one-directional line), so no
+*** pixels are lost.
+**/
+void LaosMotion::startBitmapLine(float x0, float y0, const tActionRequest *line, bool reverse) {
+  extern GlobalConfig *cfg;
+  m_RasterSeg = *line;
+  m_RasterSeg.bitmap_reverse = reverse;
+  m_RasterTraced = false;
+  if (!bitmapValid()) {
+    m_RasterSeg.bitmap_ofs = (reverse && bitmap_width ? bitmap_width - 1 : 0);
+    m_RasterSeg.bitmap_len = bitmap_width;
+    if (reverse) {
+      m_RasterSeg.target.x = x0;
+      m_RasterSeg.target.y = y0;
+    }
+    bufferLine(&m_RasterSeg);
+    m_RasterRun = bitmap_width;  // nothing left to trace
+    return;
+  }
+
+  // start of the traversal and pixel pitch along it
+  m_RasterX = (reverse ? line->target.x : x0);
+  m_RasterY = (reverse ? line->target.y : y0);
+  m_RasterDx = ((reverse ? x0 : line->target.x) - m_RasterX) / bitmap_width;
+  m_RasterDy = ((reverse ? y0 : line->target.y) - m_RasterY) / bitmap_width;
+  float pitch = 1000.0 * sqrt(m_RasterDx * m_RasterDx + m_RasterDy * m_RasterDy);  // [um]
+  m_RasterSkip = (cfg->rasterskip > 0);
+  m_RasterGap = (m_RasterSkip && (pitch > 0)) ? (unsigned long)(cfg->rasterskip / pitch) : bitmap_width;
+  if (m_RasterGap < 1) m_RasterGap = 1;
+  // laser lead at bitmap speed [pixels]
+  m_RasterLead = (pitch > 0) ? (cfg->rasterlead * (line->target.feed_rate / 60.0) / 1000.0) / pitch : 0;
+  m_RasterHead = -m_RasterLead;
+  m_RasterRun = (m_RasterSkip ? bitmapFind(0, true, reverse) : 0);
+}
+
+/**
+*** traceBitmapLine()
+*** Enqueue the runs of the bitmap line started by startBitmapLine(), as long as m_Path
+*** has room: a line with many runs does not fit in the queues, and they may stay full
+*** for a long time (a feed hold). Returns true when the whole line is enqueued.
+**/
+bool LaosMotion::traceBitmapLine() {
+  extern GlobalConfig *cfg;
+  bool reverse = m_RasterSeg.bitmap_reverse;
+  float lead = m_RasterLead;
+  float z = m_RasterLine.target.z;
+  float v = m_RasterSeg.target.feed_rate / 60.0;  // bitmap speed [mm/sec]
+  float speed = (v < cfg->rapidspeed ? cfg->rapidspeed : v);  // of the blank runs
+  while (m_RasterRun < bitmap_width) {
+    if (m_Path.full()) return false;
+    // grow the run [a, b) until it is followed by a blank run of at least m_RasterGap pixels
+    unsigned long a = m_RasterRun;
+    unsigned long b = (m_RasterSkip ? bitmapFind(a, false, reverse) : bitmap_width);
+    unsigned long next = bitmapFind(b, true, reverse);
+    while ((next < bitmap_width) && (next - b < m_RasterGap)) {
+      b = bitmapFind(next, false, reverse);
+      next = bitmapFind(b, true, reverse);
+    }
+    // trace the pixels [a, b) with the head 'lead' pixels ahead
+    // (the overscan before a bidirectional line is sized for the bitmap speed)
+    float h = a - lead;
+    bufferTravel(m_RasterX + h * m_RasterDx, m_RasterY + h * m_RasterDy, z,
+                 (m_RasterOverscan && !m_RasterTraced) ? v : speed);  // dropped if already there
+    m_RasterSeg.ActionType = AT_BITMAP;
+    m_RasterSeg.target.x = m_RasterX + (b - lead) * m_RasterDx;
+    m_RasterSeg.target.y = m_RasterY + (b - lead) * m_RasterDy;
+    m_RasterSeg.bitmap_ofs = (reverse ? bitmap_width - 1 - a : a);
+    m_RasterSeg.bitmap_len = b - a;
+    bufferLine(&m_RasterSeg);
+    m_RasterHead = b - lead;
+    m_RasterTraced = true;
+    m_RasterRun = next;
+  }
+
+  // trailing margin: run out to the end of the line
+  if (m_RasterTraced && (m_RasterHead < bitmap_width)) {
+    if (m_Path.full()) return false;
+    bufferTravel(m_RasterX + bitmap_width * m_RasterDx, m_RasterY + bitmap_width * m_RasterDy, z, speed);
+    m_RasterHead = bitmap_width;
+  }
+  // bidirectional: overscan after the line
+  if (m_RasterOverscan) {
+    if (m_Path.full()) return false;
+    bufferTravel(m_RasterEndX, m_RasterEndY, z, v);
+    m_RasterOverscan = false;
+  }
+  return true;
+}
+
+/**
+*** startBidirBitmapLine()
+*** Start tracing a bitmap line for bidirectional engraving. The line starts at the held move
+*** (or the planned position) and ends at its target. It is traced from the end that is
+*** nearest to the planned position, so consecutive lines run in opposite directions.
+*** Both ends get an overscan of v^2/(2*a) plus the laser lead (the runs are traced 'lead'
+*** ahead of their pixels), so the head is at bitmap speed over the whole line; a is the
+*** lower of x.accel and motion.rapidaccel, because the overscan is a travel move. The
+*** overscan is travelled at the bitmap speed. A line without any set pixels is skipped
+*** entirely.
+**/
+void LaosMotion::startBidirBitmapLine(const tActionRequest *line) {
+  extern GlobalConfig *cfg;
+  float px = m_PlannedXAbsolute / 1000.0, py = m_PlannedYAbsolute / 1000.0;
+  float x0 = px, y0 = py;
+  m_RasterOverscan = false;
+  if (!bitmapValid()) {
+    flushHeldMove();
+    startBitmapLine(m_PlannedXAbsolute / 1000.0, m_PlannedYAbsolute / 1000.0, line, false);
+    return;
+  }
+  if (m_MoveHeld) {
+    x0 = m_HeldMove.target.x;
+    y0 = m_HeldMove.target.y;
+    m_MoveHeld = false;
+  }
+  if (bitmapFind(0, true, false) >= bitmap_width) {
+    m_RasterRun = bitmap_width;  // nothing to trace
+    m_RasterTraced = false;
+    return;
+  }
+
+  float lx = line->target.x - x0, ly = line->target.y - y0;
+  float len = sqrt(lx * lx + ly * ly);
+  float ax = px - x0, ay = py - y0;
+  float bx = px - line->target.x, by = py - line->target.y;
+  bool reverse = (bx * bx + by * by) < (ax * ax + ay * ay);
+
+  // overscan vector, along the direction of travel
+  float v = line->target.feed_rate / 60.0;  // [mm/sec]
+  float accel = cfg->xaccel;
+  if ((cfg->rapidaccel > 0) && (cfg->rapidaccel < accel)) accel = cfg->rapidaccel;  // the overscan is a travel move
+  float overscan = v * v / (2.0 * accel) + cfg->rasterlead * v / 1e6;  // [mm]
+  float d = (len > 0 ? overscan / len : 0);
+  float ox = (reverse ? -lx : lx) * d, oy = (reverse ? -ly : ly) * d;
+  float fx = (reverse ? line->target.x : x0), fy = (reverse ? line->target.y : y0);
+  float tx = (reverse ? x0 : line->target.x), ty = (reverse ? y0 : line->target.y);
+
+  bufferTravel(fx - ox, fy - oy, line->target.z, cfg->rapidspeed);
+  startBitmapLine(x0, y0, line, reverse);
+  m_RasterOverscan = true;
+  m_RasterEndX = tx + ox;
+  m_RasterEndY = ty + oy;
+}
+
+/**
+*** bufferTravel()
+*** Enqueue a laser-off move at the given speed [mm/sec], clipped to the machine limits
+**/
+void LaosMotion::bufferTravel(float x, float y, float z, float speed) {
+  extern GlobalConfig *cfg;
+  tActionRequest move;
+  move.ActionType = AT_MOVE;
+  move.target.x = x;
+  move.target.y = y;
+  move.target.z = z;
+  move.target.e = 0;
+  move.target.feed_rate = 60 * speed;
+  move.param = power;
+  move.aux_mask = aux_mask;
+  move.aux_value = aux_value;
+  if (move.target.x < cfg->xmin / 1000.0) move.target.x = cfg->xmin / 1000.0;
+  if (move.target.y < cfg->ymin / 1000.0) move.target.y = cfg->ymin / 1000.0;
+  if (move.target.x > cfg->xmax / 1000.0) move.target.x = cfg->xmax / 1000.0;
+  if (move.target.y > cfg->ymax / 1000.0) move.target.y = cfg->ymax / 1000.0;
+  bufferLine(&move);
+}
+
+/**
+*** startCurve()
+*** Start tracing the current curve as laser lines, at the marking speed and power.
+*** The chords are enqueued by pump(), as long as there is room.
+**/
+void LaosMotion::startCurve() {
+  m_CurveAction.ActionType = AT_LASER;
+  m_CurveAction.target.z = 0;
+  m_CurveAction.target.e = 0;
+  m_CurveAction.param = power;
+  m_CurveAction.pulse_spacing = pulse_spacing;
+  m_CurveAction.pulse_width = pulse_width;
+  m_CurveAction.aux_mask = aux_mask;
+  m_CurveAction.aux_value = aux_value;
+  m_CurveAction.target.feed_rate = 60 * mark_speed;
+  pump();
+}
+
+/**
+*** pump()
+*** Move queued work on without blocking: actions to the planner, chords of the current
+*** curve to the queue, and the bitmap work that waits for the motion queue to run empty.
+*** Returns true if no work is left over.
+**/
+bool LaosMotion::pump() {
+  extern GlobalConfig *cfg;
+  float x, y;
+  checkBuffer();
+  if (m_FlushPath) m_Path.flush();
+  m_Path.pump();
+  if (m_Wait == WAIT_RASTER_RUNS) {
+    if (!traceBitmapLine()) return false;  // wait for room in the queue
+    m_Wait = WAIT_RASTER_END;
+  }
+  while (!m_Curve.done() && !m_Path.full()) {
+    tActionRequest chord = m_CurveAction;
+    m_Curve.next(&x, &y);
+    chord.target.x = x;
+    chord.target.y = y;
+    bufferLine(&chord);
+  }
+  if (m_Wait != WAIT_NONE) {
+    m_Path.flush();
+    m_Path.pump();
+    if (m_Path.queued() || plan_queue_items()) return false;  // wait for the queue to run empty
+    m_Feeding = false;
+    switch (m_Wait) {
+      case WAIT_BITMAP_DATA:
+        bitmap_bpp = bitmap_bpp_next;
+        st_set_bitmap_bpp(bitmap_bpp);
+        bitmap_width = bitmap_width_next;
+        bitmap_enable = 1;
+        bitmap_size = (bitmap_bpp * bitmap_width) / 32;
+        if ((bitmap_bpp * bitmap_width) % 32)  // padd to next 32-bit
+          bitmap_size++;
+        // printf("\n\rBitmap: read %d dwords\n\r", bitmap_size);
+        m_Wait = WAIT_NONE;
+        break;
+      case WAIT_BITMAP_LINE:
+        plan_set_accel(cfg->xaccel);
+        if (cfg->rasterbidir)
+          startBidirBitmapLine(&m_RasterLine);
+        else
+          startBitmapLine(m_PlannedXAbsolute / 1000.0, m_PlannedYAbsolute / 1000.0, &m_RasterLine, false);
+        m_Wait = WAIT_RASTER_RUNS;
+        return false;
+      case WAIT_RASTER_RUNS:  // see above
+        break;
+      case WAIT_RASTER_END:
+        plan_set_accel(cfg->accel);
+        m_Wait = WAIT_NONE;
+        break;
+      case WAIT_POSITION:
+        m_PlannedXAbsolute = m_SetX;
+        m_PlannedYAbsolute = m_SetY;
+        m_PlannedZAbsolute = m_SetZ;
+        plan_set_current_position_xyz(m_SetX / 1000.0, m_SetY / 1000.0, m_SetZ / 1000.0);
+        m_Wait = WAIT_NONE;
+        break;
+      case WAIT_NONE:
+        break;
+    }
+  }
+  return m_Curve.done();
+}
+
+/**
+*** checkBuffer()
+*** Count an underrun if the queue ran empty while job data was expected: the reader
+*** did not keep up. This is sampled whenever work is pumped (ready(), queue(), write()),
+*** so also while the reader is stalled.
+*** Once the buffered time has been above motion.underrun, count every drop below it.
+*** While it is low, new blocks are slowed down to between motion.underrun.feed % (empty)
+*** and 100 % (at the threshold), so the buffer can recover before the head has to stop.
+**/
+void LaosMotion::checkBuffer() {
+  extern GlobalConfig *cfg;
+  float scale = 1.0;
+  if (m_Feeding && (m_Wait == WAIT_NONE) && !m_MoveHeld && !plan_queue_items() && !m_Path.queued()) {
+    m_Underruns++;
+    m_Feeding = false;
+  }
+  if (m_Feeding && (m_Wait == WAIT_NONE) && (cfg->underrun > 0)) {
+    unsigned long t = plan_queue_time_us(), low = 1000UL * cfg->underrun;
+    if (plan_queue_full() || (t >= low)) {
+      m_Filled = true;
+      m_Low = false;
+    } else if (m_Filled) {
+      if (!m_Low) m_LowBuffers++;
+      m_Low = true;
+      scale = (cfg->underrunfeed + (100 - cfg->underrunfeed) * (float)t / low) / 100.0;
+    }
+  } else {
+    m_Filled = m_Low = false;
+  }
+  plan_set_feed_scale(scale);
+}
+
+/**
+*** flushHeldMove()
+*** Enqueue the move that was held back to see if a bidirectional bitmap line follows
+**/
+void LaosMotion::flushHeldMove() {
+  if (!m_MoveHeld) return;
+  m_MoveHeld = false;
+  bufferLine(&m_HeldMove);
+}
+
 /**
 *** Return true if start button is pressed
 **/
 bool LaosMotion::isStart() {
-  return cover;
+  return io->get(IO_COVER);
 }
 
 /**
-*** Hard set the position
-*** Warning: only call when the motion is not busy!
+*** Hard set the position, once the queued motion has run out (see pump())
 *** current offset is taken into account
 **/
 void LaosMotion::setPositionRelativeToOrigin(int x, int y, int z) {
@@ -371,14 +924,15 @@ void LaosMotion::setPositionRelativeToOrigin(int x, int y, int z) {
 }
 
 /**
-*** Hard set the position
-*** Warning: only call when the motion is not busy!
+*** Hard set the position, once the queued motion has run out (see pump()). This does not
+*** wait: ready() is false until the position is set. Call this when ready().
 **/
 void LaosMotion::setPositionAbsolute(int x, int y, int z) {
-  m_PlannedXAbsolute = x;
-  m_PlannedYAbsolute = y;
-  m_PlannedZAbsolute = z;
-  plan_set_current_position_xyz(x / 1000.0, y / 1000.0, z / 1000.0);
+  m_SetX = x;
+  m_SetY = y;
+  m_SetZ = z;
+  m_Wait = WAIT_POSITION;
+  pump();
 }
 
 /**
@@ -450,45 +1004,172 @@ void LaosMotion::MakeCurrentPositionOrigin() {
 }
 
 /**
-*** Home the axis, stop when both home switches are pressed
+*** Travel direction of an axis towards its home switch: the direction signal is homedir
+*** while homing, and a negative scale inverts the direction signal
 **/
-void LaosMotion::home(int x, int y, int z) {
+static inline float homeDir(int homedir, int scale) {
+  return ((!homedir) != (scale < 0)) ? -1 : 1;
+}
+
+/**
+*** Search distance of an axis [mm]: a bit more than its range, HOME_SEARCH if it has no limits
+**/
+static float homeSearch(int min, int max) {
+  if ((max == (int)GlobalConfig::VERYLARGE) || (min == (int)GlobalConfig::MINUSVERYLARGE) || (max <= min))
+    return HOME_SEARCH;
+  return 1.2 * (max - min) / 1000.0;
+}
+
+/**
+*** homeMove()
+*** Queue the move of a homing phase for the axes in m_HomeAxes (step bits), relative to
+*** the current position. The queue must be empty. The fast approach (motion.homefast) and
+*** the slow approach (motion.homespeed, or motion.zhomespeed if only Z is homed) are
+*** AT_MOVE_ENDSTOP moves: every axis stops at its own switch.
+**/
+void LaosMotion::homeMove(THome phase) {
   extern GlobalConfig *cfg;
-  int i = 0;
-  printf("Homing %d,%d, with speed %d\n", x, y, cfg->homespeed);
-  xdir = cfg->xhomedir;
-  ydir = cfg->yhomedir;
-  zdir = cfg->zhomedir;
+  float dir[3] = {homeDir(cfg->xhomedir, cfg->xscale), homeDir(cfg->yhomedir, cfg->yscale),
+                  homeDir(cfg->zhomedir, cfg->zscale)};
+  float range[3] = {homeSearch(cfg->xmin, cfg->xmax), homeSearch(cfg->ymin, cfg->ymax),
+                    homeSearch(cfg->zmin, cfg->zmax)};
+  float backoff = cfg->homebackoff / 1000.0;
+  float dist[3];
+  tActionRequest move;
+  memset(&move, 0, sizeof(move));
+  for (int i = 0; i < 3; i++) {
+    if ((phase == HOME_FAST) || (cfg->homefast <= 0))
+      dist[i] = dir[i] * range[i];
+    else if (phase == HOME_BACK)
+      dist[i] = -dir[i] * backoff;
+    else
+      dist[i] = 2 * dir[i] * backoff;
+  }
+  if (phase == HOME_SLOW) {
+    // slow approach speed [mm/min] from the step period [usec/step]
+    if (m_HomeAxes == (1 << Z_STEP_BIT))
+      move.target.feed_rate = 60E6 / (max(cfg->zhomespeed, 1) * fabs(cfg->zscale / 1000.0));
+    else
+      move.target.feed_rate = 60E6 / (max(cfg->homespeed, 1) * fabs(cfg->xscale / 1000.0));
+  } else {
+    move.target.feed_rate = 60.0 * cfg->homefast;
+  }
+  move.ActionType = (phase == HOME_BACK) ? AT_MOVE : AT_MOVE_ENDSTOP;
+  move.target.x = (m_HomeAxes & (1 << X_STEP_BIT)) ? dist[X_AXIS] : 0;
+  move.target.y = (m_HomeAxes & (1 << Y_STEP_BIT)) ? dist[Y_AXIS] : 0;
+  move.target.z = (m_HomeAxes & (1 << Z_STEP_BIT)) ? dist[Z_AXIS] : 0;
+  plan_set_current_position_xyz(0, 0, 0);
+  plan_buffer_line(&move);
+  m_Home = phase;
+}
+
+/**
+*** homeDone()
+*** The axes in m_HomeAxes are homed (or their switch was not found). Home the next axes,
+*** or set the home position and move to it.
+**/
+void LaosMotion::homeDone(bool found) {
+  extern GlobalConfig *cfg;
+  if (!found) printf("Home switch not found\n\r");
+  if (m_HomeNext) {
+    m_HomeAxes = m_HomeNext;
+    m_HomeNext = 0;
+    printf("Home XY...\n\r");
+    homeMove(cfg->homefast > 0 ? HOME_FAST : HOME_SLOW);
+    return;
+  }
+  m_Home = HOME_IDLE;
+  led2 = !xhome;
+  led3 = !yhome;
+  setOriginAbsolute(0, 0, 0);  // reset origin
+  setPositionAbsolute(m_HomeX, m_HomeY, m_HomeZ);
+  if (!found) return;
+  moveToAbsolute(m_HomeX, m_HomeY, m_HomeZ);
+  isHome = true;
+  printf("Home done.\n\r");
+}
+
+/**
+*** startHoming()
+*** Start homing: wait for the cover, move to the home switches with the stepper, and set the
+*** specified position. Z is homed first (if sys.autozhome), or together with X and Y if
+*** motion.zhomeconcurrent is set. poll() moves it on, without blocking.
+**/
+void LaosMotion::startHoming(int x, int y, int z) {
+  extern GlobalConfig *cfg;
+  if (m_Home != HOME_IDLE) return;
+  printf("Homing %d,%d, fast %d mm/sec, slow %d usec/step\n", x, y, cfg->homefast, cfg->homespeed);
   led1 = 0;
   isHome = false;
-  printf("Home Z...\n\r");
+  m_HomeX = x;
+  m_HomeY = y;
+  m_HomeZ = z;
+  m_HomeAxes = (1 << X_STEP_BIT) | (1 << Y_STEP_BIT);
+  m_HomeNext = 0;
   if (cfg->autozhome) {
-    printf("Homing %d with speed %d\n", z, cfg->zhomespeed);
-    while ((zmin ^ cfg->zpol) && (zmax ^ cfg->zpol)) {
-      zstep = 0;
-      wait(cfg->zhomespeed / 1E6);
-      zstep = 1;
-      wait(cfg->zhomespeed / 1E6);
+    if (cfg->zhomeconcurrent) {
+      m_HomeAxes |= (1 << Z_STEP_BIT);
+    } else {
+      m_HomeNext = m_HomeAxes;
+      m_HomeAxes = (1 << Z_STEP_BIT);
     }
   }
-  printf("Home XY...\n\r");
-  while (1) {
-    xstep = ystep = 0;
-    wait(cfg->homespeed / 1E6);
-    xstep = xhome ^ cfg->xpol;
-    ystep = yhome ^ cfg->ypol;
-    wait(cfg->homespeed / 1E6);
-
-    led2 = !xhome;
-    led3 = !yhome;
-    led4 = ((i++) & 0x10000);
-    if (!(xhome ^ cfg->xpol) && !(yhome ^ cfg->ypol)) {
-      setOriginAbsolute(0, 0, 0);  // reset origin
-      setPositionAbsolute(x, y, z);
-      moveToAbsolute(x, y, z);
-      isHome = true;
-      printf("Home done.\n\r");
-      return;
-    }
+  m_Home = HOME_COVER;  // poll() waits for the queue to run empty
+  if (!isStart()) printf("Wait for cover...\n\r");
+}
+
+/**
+*** poll()
+*** Pass a move outside a job on to the planner. Finish a resume or abort once the feed
+*** hold has stopped. Move homing on: wait for the cover, and for the move of every phase
+*** to finish before the next one is queued. Call this from the main loop.
+**/
+void LaosMotion::poll() {
+  extern GlobalConfig *cfg;
+  if (m_FlushPath) pump();
+  if (!st_poll()) return;  // a resume or abort waits for the feed hold to stop
+  if (m_Aborting) {
+    m_Aborting = false;
+    reset();  // the planner continues from the actual position
+    moveToAbsolute(cfg->xrest, cfg->yrest, cfg->zrest);
+  }
+  if (m_Home == HOME_IDLE) return;
+  if (m_Home == HOME_COVER) {
+    if (!isStart() || queue()) return;
+    printf(m_HomeNext ? "Home Z...\n\r" : "Home XY...\n\r");
+    homeMove(cfg->homefast > 0 ? HOME_FAST : HOME_SLOW);
+    return;
+  }
+  if (!plan_queue_empty()) return;  // the move of this phase is running
+  switch (m_Home) {
+    case HOME_FAST:
+      if (st_endstops_hit() == m_HomeAxes)
+        homeMove(HOME_BACK);
+      else
+        homeDone(false);
+      break;
+    case HOME_BACK:
+      homeMove(HOME_SLOW);
+      break;
+    case HOME_SLOW:
+      homeDone(st_endstops_hit() == m_HomeAxes);
+      break;
+    default:
+      break;
   }
 }
+
+/**
+*** isHoming()
+**/
+bool LaosMotion::isHoming() {
+  return m_Home != HOME_IDLE;
+}
+
+/**
+*** Home the axis, and wait until done
+**/
+void LaosMotion::home(int x, int y, int z) {
+  startHoming(x, y, z);
+  while (isHoming()) poll();
+}
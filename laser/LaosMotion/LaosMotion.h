@@ -27,6 +27,12 @@
 #include "global.h"
 #include "pins.h"
 #include  "planner.h"
+#include "LaosCurve.h"
+#include "LaosPath.h"
+
+// range of the feed and power override [%]
+#define OVERRIDE_MIN 10
+#define OVERRIDE_MAX 200
 
     /** Motion Controll system
       *
@@ -45,6 +51,9 @@ public:
   int ready(); // returns true if we are ready to accept a new instruction
   void reset(); // reset the instruction decoder and motion controller
   void home(int xhome, int yhome, int zhome); // home the system, move to the sensors and set the specified position
+  void startHoming(int xhome, int yhome, int zhome); // start homing (after the cover is closed), poll() moves it on
+  bool isHoming(); // homing is in progress
+  void poll(); // move homing, resume and abort on without blocking, call from the main loop
   bool isStart(); // start button is enabled
   bool isHome; // system is homed
   void setPositionRelativeToOrigin(int x, int y, int z);
@@ -60,11 +69,64 @@ public:
   void moveToRelativeToOriginWithAbsoluteFeedrate(int x, int y, int z, int feedrate, int power, eActionType actiontype);
   void moveToAbsoluteWithAbsoluteFeedrate(int x, int y, int z, int feedrate, int power, eActionType actiontype);
   int queue(); // queued items
+  void endJob(); // all job data is written: running empty is not an underrun
+  unsigned long bufferedTime(); // estimated time of the queued motion [usec]
+  int freeSlots(); // nr of blocks that can still be queued
+  int underruns() { return m_Underruns; } // nr of times the queue ran empty during the job
+  int lowBuffers() { return m_LowBuffers; } // nr of times the buffered time dropped below motion.underrun
+  void setFeedOverride(int percent); // scale the feed of queued and new lines and moves [%]
+  int feedOverride() { return m_FeedOverride; }
+  void setPowerOverride(int percent); // scale the laser power, also of the running line [%]
+  int powerOverride() { return m_PowerOverride; }
+  void hold(); // decelerate to a stop along the path, keep the queue
+  bool resume(); // continue after hold(), returns false if the cover is still open
+  bool isHeld(); // hold() has come to a stop
+  bool interlockOpen(); // the cover opened (sys.interlock): the laser is off and the job is held
+  int interlockLatency(); // worst case interlock reaction time measured so far [usec]
+  void abort(); // stop within one deceleration distance, discard the queue, reset and move to rest (see poll)
   void getLimitsRelative(int *minx, int *miny, int *minz, int *maxx, int *maxy, int *maxz);
   void UpdatePlannedCoordinates(const tActionRequest *action);
 
 private:
+  void startBitmapLine(float x0, float y0, const tActionRequest *line, bool reverse); // start tracing a bitmap line, skipping blank runs
+  void startBidirBitmapLine(const tActionRequest *line); // start tracing a bitmap line in the nearest direction, with overscan
+  bool traceBitmapLine(); // enqueue the runs of the bitmap line as long as there is room, true when done
+  void bufferTravel(float x, float y, float z, float speed); // enqueue a laser-off move [mm/sec]
+  void flushHeldMove(); // enqueue the held move (if any)
+  void startCurve(); // start enqueueing the chords of m_Curve as laser lines
+  bool pump(); // move queued work on, returns true if none is left
+  void checkBuffer(); // count low buffer events and set the feed scale
+  bool bufferLine(const tActionRequest *action); // enqueue a move or line through m_Path, false if it is full
+  typedef enum {HOME_IDLE, HOME_COVER, HOME_FAST, HOME_BACK, HOME_SLOW} THome;
+  void homeMove(THome phase); // queue the move of a homing phase
+  void homeDone(bool found); // the axes being homed are done: home the next ones, or finish
+  THome m_Home; // homing state
+  uint32_t m_HomeAxes, m_HomeNext; // axes (step bits) being homed, and to home after them
+  int m_HomeX, m_HomeY, m_HomeZ; // position to set when homed [micron]
   int m_PlannedXAbsolute, m_PlannedYAbsolute, m_PlannedZAbsolute; // in absolute coordinates
+  tActionRequest m_HeldMove; // move to the start of a possible bidirectional bitmap line
+  bool m_MoveHeld;
+  LaosCurve m_Curve; // arc or bezier curve being segmented
+  tActionRequest m_CurveAction; // settings of the chords of m_Curve
+  typedef enum {WAIT_NONE, WAIT_BITMAP_DATA, WAIT_BITMAP_LINE, WAIT_RASTER_RUNS, WAIT_RASTER_END, WAIT_POSITION} TWait;
+  TWait m_Wait; // work that waits for the motion queue to run empty, or for room in it (WAIT_RASTER_RUNS)
+  tActionRequest m_RasterLine; // bitmap line to trace (WAIT_BITMAP_LINE)
+  tActionRequest m_RasterSeg; // settings of the runs of the bitmap line being traced
+  float m_RasterX, m_RasterY, m_RasterDx, m_RasterDy; // start of the traversal, and the pixel pitch along it [mm]
+  float m_RasterLead, m_RasterHead; // laser lead, and position of the head along the line [pixels]
+  unsigned long m_RasterRun, m_RasterGap; // first pixel of the next run, shortest blank run to travel over [pixels]
+  bool m_RasterSkip, m_RasterTraced; // blank runs are skipped, a run has been traced
+  bool m_RasterOverscan; // travel to (m_RasterEndX, m_RasterEndY) after the line (bidirectional)
+  float m_RasterEndX, m_RasterEndY;
+  int m_SetX, m_SetY, m_SetZ; // position to set when the queue is empty (WAIT_POSITION) [micron]
+  LaosPath m_Path; // merges segments before they are planned
+  bool m_FlushPath; // not job data: pass the held segment on as soon as there is room
+  bool m_Feeding; // job data is queued: running empty is an underrun
+  bool m_JobEnd; // endJob() was called
+  bool m_Filled, m_Low; // buffered time has been above / is below motion.underrun
+  int m_Underruns, m_LowBuffers;
+  int m_FeedOverride, m_PowerOverride; // [%]
+  bool m_Aborting; // abort() waits for the stop
 
 };
 
@@ -0,0 +1,214 @@
+/**
+ * LaosPath.cpp
+ * Merge collinear and very short segments before they are planned
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "LaosPath.h"
+
+#include <math.h>
+
+LaosPath::LaosPath() {
+  m_Tolerance = 0;
+  m_Blend = 0;
+  m_Pending = false;
+  m_Points = 0;
+  m_Head = m_Tail = 0;
+}
+
+/**
+*** reset()
+*** Discard the held segment and all queued actions
+**/
+void LaosPath::reset() {
+  m_Pending = false;
+  m_Head = m_Tail = 0;
+}
+
+/**
+*** add()
+*** Extend the held segment with this one if possible, otherwise queue the held
+*** segment and hold this one (or queue it directly if it can not be merged at all).
+*** Returns false (and does nothing) if the queue is full().
+**/
+bool LaosPath::add(const tActionRequest *action, float x0, float y0, float z0) {
+  if (full()) return false;
+  if (m_Pending && canMerge(action, x0, y0, z0)) {
+    m_Px[m_Points] = m_Action.target.x;
+    m_Py[m_Points] = m_Action.target.y;
+    m_Points++;
+    m_Action.target = action->target;
+    return true;
+  }
+  if (m_Pending && blend(action, x0, y0, z0)) return true;
+  flush();
+  if (((m_Tolerance > 0) || (m_Blend > 0)) && ((action->ActionType == AT_MOVE) || (action->ActionType == AT_LASER)) &&
+      (action->target.z == z0)) {
+    m_Action = *action;
+    m_X0 = x0;
+    m_Y0 = y0;
+    m_Points = 0;
+    m_Pending = true;
+  } else {
+    push(action);
+  }
+  return true;
+}
+
+/**
+*** flush()
+*** Queue the held segment. It stays held if the queue is full.
+**/
+void LaosPath::flush() {
+  if (m_Pending && push(&m_Action)) m_Pending = false;
+}
+
+/**
+*** push()
+*** Add an action to the output queue. Returns false if the queue is full: the planner
+*** may not free a slot for a long time (a feed hold), so this does not wait.
+**/
+bool LaosPath::push(const tActionRequest *action) {
+  int next = (m_Head + 1) % PATH_FIFO_SIZE;
+  if (next == m_Tail) {
+    pump();
+    if (next == m_Tail) return false;
+  }
+  m_Fifo[m_Head] = *action;
+  m_Head = next;
+  return true;
+}
+
+/**
+*** pump()
+*** Move queued actions to the planner until it is full
+**/
+void LaosPath::pump() {
+  while ((m_Tail != m_Head) && plan_try_buffer_action(&m_Fifo[m_Tail])) m_Tail = (m_Tail + 1) % PATH_FIFO_SIZE;
+}
+
+/**
+*** full()
+*** An add() queues at most PATH_MAX_ADD actions
+**/
+bool LaosPath::full() const {
+  int used = (m_Head - m_Tail + PATH_FIFO_SIZE) % PATH_FIFO_SIZE;
+  return used + PATH_MAX_ADD > PATH_FIFO_SIZE - 1;
+}
+
+/**
+*** queued()
+**/
+int LaosPath::queued() const {
+  return (m_Head - m_Tail + PATH_FIFO_SIZE) % PATH_FIFO_SIZE + (m_Pending ? 1 : 0);
+}
+
+/**
+*** sameSettings()
+*** The segment is of the same kind as the held segment, in the same plane
+**/
+bool LaosPath::sameSettings(const tActionRequest *action, float z0) const {
+  if ((action->ActionType != m_Action.ActionType) || (action->target.feed_rate != m_Action.target.feed_rate) ||
+      (action->param != m_Action.param) || (action->target.z != m_Action.target.z) || (z0 != m_Action.target.z) ||
+      (action->aux_mask != m_Action.aux_mask) || (action->aux_value != m_Action.aux_value))
+    return false;
+  if ((action->ActionType == AT_LASER) && ((action->pulse_spacing != m_Action.pulse_spacing) ||
+                                           (action->pulse_width != m_Action.pulse_width)))
+    return false;
+  return true;
+}
+
+/**
+*** blend()
+*** Replace the corner between the held laser line and this one by a circular fillet whose
+*** middle is m_Blend from the corner. For a deflection angle phi, the fillet starts and ends
+*** L = m_Blend sin(phi/2) / (1 - cos(phi/2)) from the corner. L is limited to the held
+*** segment (which may already be shortened by the previous fillet) and to half of the new
+*** one (to leave room for the next fillet). The held segment is queued up to the fillet,
+*** followed by the chords of the fillet, and the new segment is held from the end of it.
+*** Returns false if the corner is not blended.
+**/
+bool LaosPath::blend(const tActionRequest *action, float x0, float y0, float z0) {
+  if ((m_Blend <= 0) || (action->ActionType != AT_LASER) || !sameSettings(action, z0)) return false;
+  if ((fabs(x0 - m_Action.target.x) > 0.001) || (fabs(y0 - m_Action.target.y) > 0.001)) return false;
+
+  float ax = m_Action.target.x - m_X0, ay = m_Action.target.y - m_Y0;
+  float bx = action->target.x - x0, by = action->target.y - y0;
+  float lena = sqrt(ax * ax + ay * ay), lenb = sqrt(bx * bx + by * by);
+  if ((lena <= 0) || (lenb <= 0)) return false;
+  ax /= lena;
+  ay /= lena;
+  bx /= lenb;
+  by /= lenb;
+  float cos_phi = ax * bx + ay * by;
+  if ((cos_phi > 0.9998) || (cos_phi < -0.98)) return false;  // nearly straight (< ~1 deg), or a reversal
+
+  float cos_half = sqrt(0.5 * (1 + cos_phi)), sin_half = sqrt(0.5 * (1 - cos_phi));
+  float len = m_Blend * sin_half / (1 - cos_half);
+  if (len > lena) len = lena;
+  if (len > lenb / 2) len = lenb / 2;
+  float r = len * cos_half / sin_half;
+  bool ccw = (ax * by - ay * bx) > 0;
+  float sx = x0 - len * ax, sy = y0 - len * ay;  // fillet start
+  float cx = sx + (ccw ? -ay : ay) * r, cy = sy + (ccw ? ax : -ax) * r;
+
+  tActionRequest chord = m_Action;
+  m_Action.target.x = sx;
+  m_Action.target.y = sy;
+  flush();
+  m_Fillet.arc(sx, sy, x0 + len * bx, y0 + len * by, cx, cy, ccw, m_Blend / 4);
+  while (m_Fillet.next(&chord.target.x, &chord.target.y)) push(&chord);
+
+  m_Action = *action;
+  m_X0 = x0 + len * bx;
+  m_Y0 = y0 + len * by;
+  m_Points = 0;
+  m_Pending = true;
+  return true;
+}
+
+/**
+*** canMerge()
+*** The segment can be merged if it has the same settings, continues the held segment,
+*** and all points in between lie within the tolerance of the merged segment, without
+*** going back along it.
+**/
+bool LaosPath::canMerge(const tActionRequest *action, float x0, float y0, float z0) const {
+  if ((m_Tolerance <= 0) || !sameSettings(action, z0)) return false;
+  if ((fabs(x0 - m_Action.target.x) > m_Tolerance) || (fabs(y0 - m_Action.target.y) > m_Tolerance)) return false;
+  if (m_Points >= PATH_MAX_POINTS) return false;
+
+  float dx = action->target.x - m_X0, dy = action->target.y - m_Y0;
+  float len = sqrt(dx * dx + dy * dy);
+  if (len > 0) {
+    dx /= len;
+    dy /= len;
+  }
+  for (int i = 0; i <= m_Points; i++) {
+    float px = (i < m_Points ? m_Px[i] : m_Action.target.x) - m_X0;
+    float py = (i < m_Points ? m_Py[i] : m_Action.target.y) - m_Y0;
+    if (len <= m_Tolerance) {
+      // very short result: all points must be near the start
+      if (sqrt(px * px + py * py) > m_Tolerance) return false;
+      continue;
+    }
+    float along = px * dx + py * dy;
+    if ((along < -m_Tolerance) || (along > len + m_Tolerance)) return false;
+    if (fabs(px * dy - py * dx) > m_Tolerance) return false;
+  }
+  return true;
+}
@@ -0,0 +1,83 @@
+/**
+ * LaosPath.h
+ * Merge collinear and very short segments before they are planned
+ *
+ *   This file is part of the LaOS project (see: http://laoslaser.org)
+ *
+ *   LaOS is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   LaOS is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with LaOS.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef _LAOSPATH_H_
+#define _LAOSPATH_H_
+
+#include "planner.h"
+#include "LaosCurve.h"
+
+// max. nr of points that can be merged into one segment
+#define PATH_MAX_POINTS 16
+// size of the output queue to the planner
+#define PATH_FIFO_SIZE 16
+// max. nr of actions queued by one add(): the held segment, the chords of a corner fillet, the new one
+#define PATH_MAX_ADD 6
+
+    /** Pre-planner stage: holds back the last move or laser line and extends it
+      * with the following ones, as long as all the points in between stay within
+      * the tolerance [mm] of the merged segment. This merges nearly collinear runs
+      * and folds segments shorter than the tolerance into their neighbours. Other
+      * actions (bitmap lines, homing moves) are passed on unchanged.
+      * Optionally, corners between laser lines are replaced by a fillet that stays
+      * within the blend tolerance [mm] of the corner, so they can be cut at speed.
+      * The output is queued, and moved to the planner by pump() without blocking.
+      * Nothing blocks: add() refuses a segment if the queue is full(), so the caller
+      * can retry later (e.g. while a feed hold keeps the planner full).
+      *
+      * Example:
+      * @code
+      * LaosPath path;
+      * path.setTolerance(0.01);
+      * if (!path.full())
+      *   path.add(&action, x0, y0, z0);
+      * path.pump();
+      * @endcode
+      */
+class LaosPath {
+public:
+  LaosPath();
+  void setTolerance(float tolerance) { m_Tolerance = tolerance; } // merge tolerance [mm], 0: off
+  void setBlend(float tolerance) { m_Blend = tolerance; } // corner blend tolerance [mm], 0: off
+  bool add(const tActionRequest *action, float x0, float y0, float z0); // add a segment from (x0,y0,z0) to the target of action, false if full()
+  void flush(); // queue the held segment (if any, and if there is room)
+  void pump(); // move queued actions to the planner, as long as it has room
+  bool full() const; // true if add() might have to wait for the planner
+  int queued() const; // nr of actions held or queued
+  void reset(); // discard the held segment and the queue
+
+private:
+  bool sameSettings(const tActionRequest *action, float z0) const;
+  bool canMerge(const tActionRequest *action, float x0, float y0, float z0) const;
+  bool blend(const tActionRequest *action, float x0, float y0, float z0);
+  bool push(const tActionRequest *action);
+
+  float m_Tolerance, m_Blend;
+  LaosCurve m_Fillet;             // corner fillet being queued
+  bool m_Pending;                 // a segment is held
+  tActionRequest m_Action;        // the held segment, up to its (merged) target
+  float m_X0, m_Y0;               // start of the held segment
+  float m_Px[PATH_MAX_POINTS], m_Py[PATH_MAX_POINTS]; // points merged into the held segment
+  int m_Points;
+  tActionRequest m_Fifo[PATH_FIFO_SIZE]; // output queue to the planner
+  int m_Head, m_Tail;
+};
+
+#endif
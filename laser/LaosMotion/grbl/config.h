@@ -37,7 +37,12 @@ typedef struct config_s
   int32_t maximum_feedrate_z;
   int32_t maximum_feedrate_e;
   float  acceleration;
-  float  junction_deviation;
+  float  rapid_acceleration; // laser-off moves
+  float  junction_deviation; // laser lines
+  float  junction_deviation_move; // laser-off moves
+  float  junction_deviation_raster; // bitmap lines
+  float  ramp_period_x; // damped ringing period [sec], 0: no ramp time quantisation
+  float  ramp_period_y;
 } config_t;
 
 #endif
\ No newline at end of file
@@ -49,12 +49,49 @@ static volatile uint8_t block_buffer_tail;       // Index of the block to proces
 static int32_t position[NUM_AXES];             // The current position of the tool in absolute steps
 static float previous_unit_vec[NUM_AXES];     // Unit vector of previous path line segment
 static float previous_nominal_speed;   // Nominal speed of previous path line segment
+static float previous_junction_deviation; // Junction deviation of previous path line segment
+static float previous_acceleration;       // Acceleration of previous path line segment
+static uint32_t queued_us;                // Total estimated time of all blocks ever queued [usec]
+static volatile uint32_t executed_us;     // Total estimated time of all blocks executed [usec]
+static float feed_scale;                  // Scale factor for the feed rate of new blocks
+static float feed_override;               // Feed override of queued and new blocks
+static uint32_t last_block_id;            // Id of the last queued block
+static float mm_per_step[3];              // Inverse of steps_per_mm of x, y and z
 
 static uint8_t acceleration_manager_enabled;   // Acceleration management active?
 
 static float rounde[NUM_AXES]; // Rounding errors.
 
 
+// Return the damped ringing period [sec] for a frequency [Hz] and damping ratio [%], 0 if not set
+static float ringing_period(int freq, int damping) {
+  if (freq <= 0) { return 0; }
+  float zeta = min(max(damping, 0), 99) / 100.0;
+  return 1.0 / (freq * sqrt(1.0 - zeta*zeta));
+}
+
+// Residual vibration after a constant acceleration ramp of "time" [sec], for a damped ringing
+// "period" [sec] and damping ratio [%]: the ringing started by the acceleration and the ringing
+// stopped by its end add up. Relative to the ringing of an acceleration that does not end:
+// 0 if the ramp cancels its own ringing, up to 2 if it doubles it.
+float plan_ramp_vibration(float time, float period, int damping) {
+  if (period <= 0) { return 1; }
+  float zeta = min(max(damping, 0), 99) / 100.0;
+  float wd = 2.0 * 3.14159265 / period; // damped angular frequency [rad/sec]
+  float decay = exp(-zeta / sqrt(1.0 - zeta*zeta) * wd * time);
+  return sqrt(1.0 + decay*decay - 2.0*decay*cos(wd*time));
+}
+
+// Print the residual vibration of a ramp from rest to "speed" [mm/sec] at motion.accel, with
+// and without ramp time quantisation
+static void print_ramp_vibration(const char *axis, float speed, float period, int damping) {
+  extern GlobalConfig *cfg;
+  if (period <= 0 || cfg->accel <= 0) { return; }
+  float t = speed / cfg->accel;
+  printf("ramp vibration %s %f (not quantised %f)...\n", axis,
+    plan_ramp_vibration(ceil(t / period) * period, period, damping), plan_ramp_vibration(t, period, damping));
+}
+
 // initial entry point of the planner
 // Clear values and set defaults
 void plan_init() {
@@ -65,6 +102,11 @@ void plan_init() {
   clear_vector(position);
   clear_vector_double(previous_unit_vec);
   previous_nominal_speed = 0.0;
+  previous_junction_deviation = 0.0;
+  previous_acceleration = 0.0;
+  queued_us = executed_us = 0;
+  feed_scale = feed_override = 1.0;
+  last_block_id = 0;
 
   memset (&startpoint, 0, sizeof(startpoint));
 
@@ -78,13 +120,20 @@ void plan_init() {
   config.maximum_feedrate_z = 60 * cfg->zspeed;
   config.maximum_feedrate_e = 60 * cfg->espeed;
   config.acceleration = cfg->accel; // [mm/sec2]
+  config.rapid_acceleration = cfg->rapidaccel; // [mm/sec2]
   config.junction_deviation = cfg->tolerance/1000.0; //  convert tolerance from [micron] to [mm]
+  config.junction_deviation_move = cfg->movetolerance/1000.0;
+  config.junction_deviation_raster = cfg->rastertolerance/1000.0;
+  config.ramp_period_x = ringing_period(cfg->xrampfreq, cfg->xrampdamping);
+  config.ramp_period_y = ringing_period(cfg->yrampfreq, cfg->yrampdamping);
   rounde[X_AXIS]=0;
   rounde[Y_AXIS]=0;
   rounde[Z_AXIS]=0;
+  // position read-out: multiply, do not divide
+  mm_per_step[X_AXIS] = 1.0 / config.steps_per_mm_x;
+  mm_per_step[Y_AXIS] = 1.0 / config.steps_per_mm_y;
+  mm_per_step[Z_AXIS] = 1.0 / config.steps_per_mm_z;
 
-
-  config.junction_deviation = 0.05;
  //  config.steps_per_mm_x =  config.steps_per_mm_y =  config.steps_per_mm_z =  config.steps_per_mm_e = 200;
   // config.acceleration = 200;
   //config.maximum_feedrate_x =  config.maximum_feedrate_y =  config.maximum_feedrate_z =  config.maximum_feedrate_e = 60000;
@@ -93,6 +142,11 @@ void plan_init() {
   printf("steps_per_mm_z %f...\n", (float)config.steps_per_mm_z);
   printf("steps_per_mm_e %f...\n", (float)config.steps_per_mm_e);
   printf("accel %f...\n", (float)config.acceleration);
+  printf("junction deviation %f/%f/%f...\n", (float)config.junction_deviation,
+    (float)config.junction_deviation_move, (float)config.junction_deviation_raster);
+  printf("ramp period x/y %f/%f...\n", (float)config.ramp_period_x, (float)config.ramp_period_y);
+  print_ramp_vibration("x", cfg->xspeed, config.ramp_period_x, cfg->xrampdamping);
+  print_ramp_vibration("y", cfg->yspeed, config.ramp_period_y, cfg->yrampdamping);
   printf("Motion: double=%d, float=%d, block=%d\n", sizeof(double), sizeof(float), sizeof(block_t));
 
 }
@@ -170,7 +224,7 @@ static void planner_reverse_pass_kernel(block_t *previous, block_t *current, blo
       // for max allowable speed if block is decelerating and nominal length is false.
       if ((!current->nominal_length_flag) && (current->max_entry_speed > next->entry_speed)) {
         current->entry_speed = min( current->max_entry_speed,
-          max_allowable_speed(-config.acceleration,next->entry_speed,current->millimeters));
+          max_allowable_speed(-current->acceleration,next->entry_speed,current->millimeters));
       } else {
         current->entry_speed = current->max_entry_speed;
       }
@@ -208,7 +262,7 @@ static void planner_forward_pass_kernel(block_t *previous, block_t *current, blo
   if (!previous->nominal_length_flag) {
     if (previous->entry_speed < current->entry_speed) {
       float entry_speed = min( current->entry_speed,
-        max_allowable_speed(-config.acceleration,previous->entry_speed,previous->millimeters) );
+        max_allowable_speed(-previous->acceleration,previous->entry_speed,previous->millimeters) );
 
       // Check for junction speed change
       if (current->entry_speed != entry_speed) {
@@ -249,7 +303,10 @@ static void planner_forward_pass() {
 // The factors represent a factor of braking and must be in the range 0.0-1.0.
 // This converts the planner parameters to the data required by the stepper controller.
 // NOTE: Final rates must be computed in terms of their respective blocks.
+static void set_block_time(block_t *block);
 static void calculate_trapezoid_for_block(block_t *block, float entry_factor, float exit_factor) {
+  if (block->action_type == AT_WAIT) { return; } // no motion, fixed time
+
 
   block->initial_rate = ceil(block->nominal_rate*entry_factor); // (step/min)
   block->final_rate = ceil(block->nominal_rate*exit_factor); // (step/min)
@@ -275,6 +332,28 @@ static void calculate_trapezoid_for_block(block_t *block, float entry_factor, fl
 
   block->accelerate_until = accelerate_steps;
   block->decelerate_after = accelerate_steps+plateau_steps;
+  set_block_time(block);
+}
+
+// Estimate the execution time of a block from its trapezoid, and keep the total of queued time
+// up to date. The peak rate is lower than the nominal rate if the block does not cruise.
+static void set_block_time(block_t *block) {
+  if (block->action_type == AT_WAIT) {
+    queued_us += block->dwell_us - block->time_us;
+    block->time_us = block->dwell_us;
+    return;
+  }
+  float vi = block->initial_rate, vf = block->final_rate; // (step/min)
+  float vp = vi*vi + 2.0*block->rate_delta*ACCELERATION_TICKS_PER_SECOND*60.0*block->accelerate_until;
+  vp = min(sqrt(vp), (float)block->nominal_rate);
+  if (vp <= 0) vp = 1;
+  float decelerate_steps = block->step_event_count - block->decelerate_after;
+  float t = (block->rate_delta == 0) ? block->step_event_count / vp : // (min)
+    2.0*block->accelerate_until/(vi+vp) + (block->decelerate_after - block->accelerate_until)/vp +
+    2.0*decelerate_steps/(vp+vf);
+  uint32_t us = t * 60.0E6;
+  queued_us += us - block->time_us;
+  block->time_us = us;
 }
 
 /*                            PLANNER SPEED DEFINITION
@@ -355,6 +434,7 @@ int plan_is_acceleration_manager_enabled() {
 
 void plan_discard_current_block() {
   if (block_buffer_head != block_buffer_tail) {
+    executed_us += block_buffer[block_buffer_tail].time_us;
     block_buffer_tail = next_block_index( block_buffer_tail );
   }
 }
@@ -364,9 +444,15 @@ block_t *plan_get_current_block() {
   return(&block_buffer[block_buffer_tail]);
 }
 
+block_t *plan_get_next_block() {
+  if (plan_queue_items() < 2) { return(NULL); }
+  return(&block_buffer[next_block_index( block_buffer_tail )]);
+}
+
 // Add a new Action movement to the buffer. x, y and z is the signed, absolute target position in
 // millimeters. Feed rate specifies the speed of the motion.
-void plan_buffer_line (tActionRequest *pAction)
+// Returns 0 (and changes nothing) if the buffer is full, 1 if the action is taken.
+uint8_t plan_try_buffer_line (tActionRequest *pAction)
 {
   float x;
   float y;
@@ -375,10 +461,19 @@ void plan_buffer_line (tActionRequest *pAction)
   bool e_only = false;
   float speed_x, speed_y, speed_z, speed_e; // Nominal mm/minute for each axis
 
+  // Would block: leave all state untouched, so the action can be retried
+  if ( plan_queue_full() ) return 0;
+
   x = pAction->target.x;
   y = pAction->target.y;
   z = pAction->target.z;
   feed_rate = pAction->target.feed_rate;
+  float base_speed = 0;
+  if ( pAction->ActionType != AT_BITMAP ) // the raster lead assumes the bitmap speed
+  {
+    base_speed = feed_rate * feed_scale;
+    feed_rate = base_speed * feed_override;
+  }
 
   #ifdef READ_FILE_DEBUG
 		printf("> ACTION type: %i target: (x:%f y:%f f:%f) power: %" SCNd16 "\n",pAction->ActionType,x,y,(float)feed_rate,pAction->param);
@@ -407,15 +502,18 @@ void plan_buffer_line (tActionRequest *pAction)
   // Calculate the buffer head after we push this byte
   int next_buffer_head = next_block_index( block_buffer_head );
 
-  // If the buffer is full: good! That means we are well ahead of the robot.
-  // Rest here until there is room in the buffer.
-  while(block_buffer_tail == next_buffer_head) { sleep_mode(); }
 
   // Prepare to set up new block
   block_t *block = &block_buffer[block_buffer_head];
 
   block->action_type = AT_MOVE;
+  block->id = ++last_block_id;
   block->power = pAction->param;
+  block->time_us = 0;
+  // laser-off moves use the rapid acceleration, if set (it may also be lower, for a gentler travel)
+  block->acceleration = config.acceleration;
+  if ( (pAction->ActionType == AT_MOVE) && (config.rapid_acceleration > 0) )
+    block->acceleration = config.rapid_acceleration;
 
   // Compute direction bits for this block
   block->direction_bits = 0;
@@ -433,7 +531,7 @@ void plan_buffer_line (tActionRequest *pAction)
   block->step_event_count = max(block->step_event_count, block->steps_e);
 
   // Bail if this is a zero-length block
-  if (block->step_event_count == 0) { return; };
+  if (block->step_event_count == 0) { return 1; };
 
   // Compute path vector in terms of absolute step target and current positions
   float delta_mm[NUM_AXES];
@@ -495,6 +593,30 @@ void plan_buffer_line (tActionRequest *pAction)
   block->nominal_speed = block->millimeters * multiplier;    // mm per min
   block->nominal_rate = ceil(block->step_event_count * multiplier);   // steps per minute
 
+  // Keep what the feed override needs to rescale this block later on
+  float max_factor = 1.0e9;
+  if (speed_x != 0) { max_factor = min(max_factor, config.maximum_feedrate_x / fabs(speed_x)); }
+  if (speed_y != 0) { max_factor = min(max_factor, config.maximum_feedrate_y / fabs(speed_y)); }
+  if (speed_z != 0) { max_factor = min(max_factor, config.maximum_feedrate_z / fabs(speed_z)); }
+  if (speed_e != 0) { max_factor = min(max_factor, config.maximum_feedrate_e / fabs(speed_e)); }
+  block->max_speed = block->nominal_speed * max_factor;
+  block->base_speed = base_speed;
+  block->corner_speed = 0;
+
+  // Ramp time quantisation (not a full input shaper): a constant acceleration that lasts a whole
+  // nr of ringing periods leaves (almost) no residual vibration (see plan_ramp_vibration()).
+  // Lower the acceleration so that a ramp between rest and the nominal speed does, for the
+  // ringing period of the axis that moves most. Ramps between other speeds (junctions, slower
+  // blocks, a feed override changed later on) and the partial ramps of blocks that are too
+  // short to reach the nominal speed are not matched, and the ringing of the other axis is not
+  // taken into account.
+  float period = (fabs(delta_mm[X_AXIS]) >= fabs(delta_mm[Y_AXIS])) ? config.ramp_period_x : config.ramp_period_y;
+  if ( (period > 0) && (block->steps_x || block->steps_y) )
+  {
+    float ramp_time = block->nominal_speed / 60.0 / block->acceleration; // [sec]
+    block->acceleration = block->nominal_speed / 60.0 / (ceil(ramp_time / period) * period);
+  }
+
 
   // Compute the acceleration rate for the trapezoid generator. Depending on the slope of the line
   // average travel per step event changes. For a line along one axis the travel per step event
@@ -504,7 +626,7 @@ void plan_buffer_line (tActionRequest *pAction)
   // specifically for each line to compensate for this phenomenon:
   // Convert universal acceleration for direction-dependent stepper rate change parameter
   block->rate_delta = ceil( block->step_event_count*inverse_millimeters *
-        config.acceleration*60.0 / ACCELERATION_TICKS_PER_SECOND ); // (step/min/acceleration_tick)
+        block->acceleration*60.0 / ACCELERATION_TICKS_PER_SECOND ); // (step/min/acceleration_tick)
 
   // Perform planner-enabled calculations
   if (acceleration_manager_enabled  )
@@ -527,6 +649,13 @@ void plan_buffer_line (tActionRequest *pAction)
     // nonlinearities of both the junction angle and junction velocity.
     float vmax_junction = MINIMUM_PLANNER_SPEED; // Set default max junction speed
 
+    // Junction deviation for this kind of action. A junction between two kinds uses the smallest.
+    float junction_deviation = config.junction_deviation;
+    if ( pAction->ActionType == AT_MOVE )
+      junction_deviation = config.junction_deviation_move;
+    else if ( pAction->ActionType == AT_BITMAP )
+      junction_deviation = config.junction_deviation_raster;
+
     // Skip first block or when previous_nominal_speed is used as a flag for homing and offset cycles.
     if ((block_buffer_head != block_buffer_tail) && (previous_nominal_speed > 0.0)) {
       // Compute cosine of angle between previous and current path. (prev_unit_vec is negative)
@@ -538,19 +667,21 @@ void plan_buffer_line (tActionRequest *pAction)
       // Skip and use default max junction speed for 0 degree acute junction.
       if (cos_theta < 0.95) {
         vmax_junction = min(previous_nominal_speed,block->nominal_speed);
+        block->corner_speed = 1.0e9;
         // Skip and avoid divide by zero for straight junctions at 180 degrees. Limit to min() of nominal speeds.
         if (cos_theta > -0.95) {
           // Compute maximum junction velocity based on maximum acceleration and junction deviation
           float sin_theta_d2 = sqrt(0.5*(1.0-cos_theta)); // Trig half angle identity. Always positive.
-          vmax_junction = min(vmax_junction,
-            sqrt(config.acceleration*60*60 * config.junction_deviation * sin_theta_d2/(1.0-sin_theta_d2)) );
+          block->corner_speed =
+            sqrt(min(block->acceleration, previous_acceleration)*60*60 * min(junction_deviation, previous_junction_deviation) * sin_theta_d2/(1.0-sin_theta_d2));
+          vmax_junction = min(vmax_junction, block->corner_speed);
         }
       }
     }
     block->max_entry_speed = vmax_junction;
 
     // Initialize block entry speed. Compute based on deceleration to user-defined MINIMUM_PLANNER_SPEED.
-    float v_allowable = max_allowable_speed(-config.acceleration,MINIMUM_PLANNER_SPEED,block->millimeters);
+    float v_allowable = max_allowable_speed(-block->acceleration,MINIMUM_PLANNER_SPEED,block->millimeters);
     block->entry_speed = min(vmax_junction, v_allowable);
 
     // Initialize planner efficiency flags
@@ -568,6 +699,8 @@ void plan_buffer_line (tActionRequest *pAction)
     // Update previous path unit_vector and nominal speed
     memcpy(previous_unit_vec, unit_vec, sizeof(unit_vec)); // previous_unit_vec[] = unit_vec[]
     previous_nominal_speed = block->nominal_speed;
+    previous_junction_deviation = junction_deviation;
+    previous_acceleration = block->acceleration;
 
   } else {
     // Acceleration planner disabled. Set minimum that is required.
@@ -577,14 +710,34 @@ void plan_buffer_line (tActionRequest *pAction)
     block->accelerate_until = 0;
     block->decelerate_after = block->step_event_count;
     block->rate_delta = 0;
+    set_block_time(block);
   }
 
  // check action options
   block->check_endstops = (pAction->ActionType == AT_MOVE_ENDSTOP);
+  block->step_mm = block->step_event_count ? block->millimeters / block->step_event_count : 0;
+  block->aux_mask = pAction->aux_mask;
+  block->aux_value = pAction->aux_value;
+  block->pulse_step = 0;
   if (  pAction->ActionType == AT_LASER )
+  {
     block->options = OPT_LASER_ON;
+    if ( pAction->pulse_spacing )
+    {
+      // pulses per distance: the stepper accumulates the travel per step event
+      block->pulse_step = (1000.0 * (1<<10) * block->millimeters) / block->step_event_count;
+      if ( block->pulse_step == 0 )
+        block->pulse_step = 1;
+      block->pulse_spacing = (int32_t)pAction->pulse_spacing << 10;
+      block->pulse_width = pAction->pulse_width;
+    }
+  }
   else if (  pAction->ActionType == AT_BITMAP )
-    block->options = OPT_BITMAP;
+  {
+    block->options = OPT_BITMAP | (pAction->bitmap_reverse ? OPT_BITMAP_REV : 0);
+    block->bitmap_ofs = pAction->bitmap_ofs;
+    block->bitmap_len = pAction->bitmap_len;
+  }
   else
     block->options = 0;
 
@@ -601,47 +754,69 @@ void plan_buffer_line (tActionRequest *pAction)
 
   if (acceleration_manager_enabled) { planner_recalculate(); }
   st_wake_up();
+  return 1;
 }
 
+// Add a new linear movement to the buffer. Rest here until there is room in the buffer.
+void plan_buffer_line (tActionRequest *pAction)
+{
+  while ( !plan_try_buffer_line(pAction) ) { sleep_mode(); }
+}
 
-// push a wait (dwell) in the motion queue
-void plan_buffer_wait (tActionRequest *pAction)
+
+// push a wait (dwell) in the motion queue: the motion comes to a stop, and the position is held
+// for dwell_us, with the laser at power param (0: off). The next block starts from rest.
+// Returns 0 (and changes nothing) if the buffer is full, 1 if the action is taken.
+uint8_t plan_try_buffer_wait (tActionRequest *pAction)
 {
+  if ( plan_queue_full() ) return 0;
 
   // Calculate the buffer head after we push this block
   int next_buffer_head = next_block_index( block_buffer_head );
 
-  // If the buffer is full: good! That means we are well ahead of the robot.
-  // Rest here until there is room in the buffer.
-  while(block_buffer_tail == next_buffer_head) { sleep_mode(); }
-
   // Prepare to set up new block
   block_t *block = &block_buffer[block_buffer_head];
 
-  //TODO
-
-  block->action_type = pAction->ActionType;
-  // every 50ms
-  block->millimeters = 10;
-  block->nominal_speed = 600;
-  block->nominal_rate = 20*60;
-
-  block->step_event_count = 1000;
-
-    // Acceleration planner disabled. Set minimum that is required.
-    block->entry_speed = block->nominal_speed;
-
-    block->initial_rate = block->nominal_rate;
-    block->final_rate = block->nominal_rate;
-    block->accelerate_until = 0;
-    block->decelerate_after = block->step_event_count;
-    block->rate_delta = 0;
+  block->action_type = AT_WAIT;
+  block->id = ++last_block_id;
+  block->step_mm = 0;
+  block->aux_mask = pAction->aux_mask;
+  block->aux_value = pAction->aux_value;
+  block->dwell_us = pAction->dwell_us;
+  block->power = pAction->param;
+  block->options = ( pAction->param ? OPT_LASER_ON : 0 );
+  block->pulse_step = 0;
+  block->check_endstops = false;
+  block->time_us = 0;
+  block->base_speed = block->corner_speed = 0;
+
+  // No travel. Entry and exit at the minimum speed makes the planner stop the motion before it.
+  block->millimeters = 0;
+  block->step_event_count = 0;
+  block->steps_x = block->steps_y = block->steps_z = block->steps_e = 0;
+  block->nominal_speed = block->max_entry_speed = block->entry_speed = MINIMUM_PLANNER_SPEED;
+  block->nominal_rate = 0;
+  block->rate_delta = 0;
+  block->acceleration = config.acceleration;
+  block->nominal_length_flag = true;
+  block->recalculate_flag = true;
+
+  // The next line starts from rest
+  previous_nominal_speed = 0.0;
 
   // Move buffer head
   block_buffer_head = next_buffer_head;
+  set_block_time(block);
 
   if (acceleration_manager_enabled) { planner_recalculate(); }
   st_wake_up();
+  return 1;
+}
+
+// push a wait (dwell) in the motion queue. Rest here until there is room in the buffer.
+void plan_buffer_wait (tActionRequest *pAction)
+{
+  while ( !plan_try_buffer_wait(pAction) ) { sleep_mode(); }
 }
 
 // Enqueue an action. Either move, laser, endstop or wait.
@@ -661,12 +836,48 @@ void plan_buffer_action(tActionRequest *pAction)
   }
 }
 
+// Try to enqueue an action. Returns 0 (and changes nothing) if the buffer is full.
+uint8_t plan_try_buffer_action(tActionRequest *pAction)
+{
+  if ( pAction->ActionType == AT_WAIT )
+    return plan_try_buffer_wait (pAction);
+  return plan_try_buffer_line (pAction);
+}
+
+// Discard all queued blocks, and plan from the actual position from now on.
+// Only call this when the stepper is stopped.
+void plan_flush()
+{
+  block_buffer_tail = block_buffer_head;
+  executed_us = queued_us;
+  position[X_AXIS] = actpos_x;
+  position[Y_AXIS] = actpos_y;
+  position[Z_AXIS] = actpos_z;
+  position[E_AXIS] = actpos_e;
+  clear_vector(rounde);
+  startpoint.x = actpos_x / config.steps_per_mm_x;
+  startpoint.y = actpos_y / config.steps_per_mm_y;
+  startpoint.z = actpos_z / config.steps_per_mm_z;
+  previous_nominal_speed = 0.0; // start from rest
+  clear_vector_double(previous_unit_vec);
+}
+
 // Reset the planner position vector and planner speed
 void plan_get_current_position_xyz(float *x, float *y, float *z)
 {
-  *x = actpos_x / config.steps_per_mm_x;
-  *y = actpos_y / config.steps_per_mm_y;
-  *z = actpos_z / config.steps_per_mm_z;
+  tStStatus status;
+  st_get_status(&status);
+  *x = status.x * mm_per_step[X_AXIS];
+  *y = status.y * mm_per_step[Y_AXIS];
+  *z = status.z * mm_per_step[Z_AXIS];
+}
+
+// End position of the queued motion
+void plan_get_planned_position_xyz(float *x, float *y, float *z)
+{
+  *x = startpoint.x;
+  *y = startpoint.y;
+  *z = startpoint.z;
 }
 
 
@@ -693,10 +904,7 @@ void plan_set_current_position(tTarget *new_position)
   // printf("Set Position: %d,%d,%d,%d", position[X_AXIS],  position[Y_AXIS],  position[Z_AXIS],  position[E_AXIS]);
   // Wait for all motion to stop and THEN set the actual stepper axis positions;
   // while( !mot->ready() );
-  actpos_x =  position[X_AXIS];
-  actpos_y =  position[Y_AXIS];
-  actpos_z =  position[Z_AXIS];
-  actpos_e =  position[E_AXIS];
+  st_set_position(position[X_AXIS], position[Y_AXIS], position[Z_AXIS], position[E_AXIS]);
 }
 
 // Force the feedrate
@@ -738,3 +946,77 @@ uint8_t plan_queue_items(void)
   return len;
 }
 
+// Return the estimated time to execute all queued blocks [usec]
+uint32_t plan_queue_time_us(void)
+{
+  return queued_us - executed_us;
+}
+
+// Scale the feed rate of blocks queued from now on (1.0: as requested)
+void plan_set_feed_scale(float scale)
+{
+  feed_scale = scale;
+}
+
+// Set the feed override. Queued blocks are rescaled from the one after the executing block,
+// the way a new block is planned: the maximum entry speeds follow from the new nominal speeds,
+// and the entry speeds are reset to what allows a stop within the block. Then the plan is
+// recalculated as usual.
+// The executing block has committed to its exit speed, so the entry speed of the next block is
+// kept. No speed is lowered below v_min, the lowest speed the head can reach there from that
+// entry speed, so the plan never asks for a faster deceleration than the acceleration.
+void plan_set_feed_override(float override)
+{
+  feed_override = override;
+  if ( !acceleration_manager_enabled || plan_queue_items() < 2 )
+    return;
+
+  int8_t block_index = next_block_index( block_buffer_tail );
+  block_t *previous = &block_buffer[block_buffer_tail];
+  float v_min = block_buffer[block_index].entry_speed;
+  block_buffer[block_index].max_entry_speed = v_min;
+  while ( block_index != block_buffer_head )
+  {
+    block_t *block = &block_buffer[block_index];
+    if ( block->base_speed > 0 )
+    {
+      block->nominal_speed = max(min(block->base_speed * feed_override, block->max_speed), v_min);
+      block->nominal_rate = ceil(block->step_event_count * block->nominal_speed / block->millimeters);
+      float v_allowable = max_allowable_speed(-block->acceleration,MINIMUM_PLANNER_SPEED,block->millimeters);
+      if ( previous != &block_buffer[block_buffer_tail] )
+      {
+        if ( block->corner_speed > 0 )
+          block->max_entry_speed = min(block->corner_speed, min(previous->nominal_speed, block->nominal_speed));
+        block->entry_speed = max(min(block->max_entry_speed, v_allowable), v_min);
+      }
+      block->nominal_length_flag = (block->nominal_speed <= v_allowable);
+      block->recalculate_flag = true;
+    }
+    // lowest speed at the end of this block
+    float v2 = v_min*v_min - 2*block->acceleration*60*60*block->millimeters;
+    v_min = (v2 > 0 ? sqrt(v2) : 0);
+    previous = block;
+    block_index = next_block_index( block_index );
+  }
+  // the next block makes its junction with the last one
+  if ( previous->base_speed > 0 )
+    previous_nominal_speed = previous->nominal_speed;
+  planner_recalculate();
+}
+
+float plan_get_feed_override(void)
+{
+  return feed_override;
+}
+
+// Return nr of blocks that can still be queued
+uint8_t plan_queue_free(void)
+{
+  return BLOCK_BUFFER_SIZE - 1 - plan_queue_items();
+}
+
+// Return the id of the last queued block (0: none yet)
+uint32_t plan_last_block_id(void)
+{
+  return last_block_id;
+}
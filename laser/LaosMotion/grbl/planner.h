@@ -48,6 +48,7 @@ typedef  struct {
 #define OPT_HOME_Z   16
 #define OPT_HOME_E   32
 #define OPT_BITMAP   64 // bitmap mark a line
+#define OPT_BITMAP_REV 128 // trace the bitmap pixels in reverse order
 
 
 // This struct is used when buffering the setup for each linear movement "nominal" values are as specified in
@@ -82,6 +83,21 @@ typedef struct
   uint8_t check_endstops; // for homing moves
   uint8_t options; // for further options (e.g. laser on/off, homing on axis, dwell, etc)
   uint16_t power; // laser power setpoint
+  float acceleration; // acceleration of this block [mm/sec2]
+  float base_speed; // nominal speed at 100% feed override [mm/min], 0: not overridden
+  float max_speed; // highest nominal speed within the axis limits [mm/min]
+  float corner_speed; // junction speed limit of the corner angle [mm/min], 0: fixed max_entry_speed
+  uint32_t time_us; // estimated execution time of this block [usec]
+  uint16_t bitmap_ofs; // first bitmap pixel traced by this block (OPT_BITMAP), the last one if OPT_BITMAP_REV
+  uint16_t bitmap_len; // nr of bitmap pixels traced by this block (OPT_BITMAP)
+  int32_t pulse_step; // PPI: travel per step event [micron, fixed point], 0: laser on continuously
+  int32_t pulse_spacing; // PPI: travel between laser pulses [micron, fixed point]
+  uint16_t pulse_width; // PPI: laser pulse width [usec]
+  uint32_t dwell_us; // AT_WAIT: dwell time [usec]
+  uint32_t id; // sequence nr of this block, counting from 1 (see plan_last_block_id)
+  float step_mm; // travel per step event [mm], 0: no travel
+  uint8_t aux_mask; // auxiliary outputs (IO_* bits of LaosIO) to set when this block starts, 0: no change
+  uint8_t aux_value; // new state of the auxiliary outputs in aux_mask
 } block_t;
 
 // This defines an action to enque, with its target position
@@ -89,6 +105,14 @@ typedef struct {
   eActionType ActionType;
   tTarget     target;
   uint16_t    param; // argument for the action
+  uint16_t    bitmap_ofs; // AT_BITMAP: first pixel of the bitmap to trace
+  uint16_t    bitmap_len; // AT_BITMAP: nr of pixels to trace
+  uint8_t     bitmap_reverse; // AT_BITMAP: trace from bitmap_ofs downwards
+  uint16_t    pulse_spacing; // AT_LASER: fire pulses every pulse_spacing [micron], 0: continuous
+  uint16_t    pulse_width; // AT_LASER: pulse width [usec]
+  uint32_t    dwell_us; // AT_WAIT: dwell time [usec], param is the laser power (0: off)
+  uint8_t     aux_mask; // auxiliary outputs (IO_* bits) to set when the action starts, 0: no change
+  uint8_t     aux_value; // new state of the auxiliary outputs in aux_mask
 } tActionRequest;
 
 
@@ -99,19 +123,34 @@ extern tTarget startpoint;
 void plan_init();
 void plan_set_accel(float a);
 
+// Residual vibration after an acceleration ramp of "time" [sec], for a ringing period [sec]
+// and damping [%], relative to an acceleration that does not end (0: none)
+float plan_ramp_vibration(float time, float period, int damping);
+
 // Add a new linear movement to the buffer. x, y and z is the signed, absolute target position in
 // millimeters. Feed rate specifies the speed of the motion. (in mm/min)
 void plan_buffer_line (tActionRequest *pAction);
 
 void plan_buffer_action(tActionRequest *pAction);
 
+// Non-blocking versions: return 0 (and change nothing) if the buffer is full, 1 if the action is taken
+uint8_t plan_try_buffer_line (tActionRequest *pAction);
+uint8_t plan_try_buffer_wait (tActionRequest *pAction);
+uint8_t plan_try_buffer_action(tActionRequest *pAction);
+
 // Called when the current block is no longer needed. Discards the block and makes the memory
 // availible for new blocks.
 void plan_discard_current_block();
 
+// Discard all queued blocks and continue from the actual position (stepper stopped)
+void plan_flush();
+
 // Gets the current block. Returns NULL if buffer empty
 block_t *plan_get_current_block();
 
+// Gets the block after the current block. Returns NULL if there is none
+block_t *plan_get_next_block();
+
 // Enables or disables acceleration-management for upcoming blocks
 void plan_set_acceleration_manager_enabled(uint8_t enabled);
 
@@ -123,6 +162,8 @@ void plan_set_current_position(tTarget *new_position);
 
 void plan_set_current_position_xyz(float x, float y, float z);
 void plan_get_current_position_xyz(float *x, float *y, float *z);
+// End position of the queued motion (the actual position if the queue is empty)
+void plan_get_planned_position_xyz(float *x, float *y, float *z);
 
 void plan_set_feed_rate (tTarget *new_position);
 
@@ -132,4 +173,20 @@ uint8_t plan_queue_empty(void);
 
 uint8_t plan_queue_items(void) ;
 
+// Return the estimated time to execute all queued blocks [usec]
+uint32_t plan_queue_time_us(void);
+
+// Return nr of blocks that can still be queued
+uint8_t plan_queue_free(void);
+
+// Return the id of the last queued block (0: none yet)
+uint32_t plan_last_block_id(void);
+
+// Scale the feed rate of new blocks (not bitmap lines)
+void plan_set_feed_scale(float scale);
+
+// Set the feed override of queued and new blocks (not bitmap lines), 1.0: as requested
+void plan_set_feed_override(float override);
+float plan_get_feed_override(void);
+
 #endif
@@ -40,18 +40,22 @@
 #include "stepper.h"
 #include "config.h"
 #include "planner.h"
+#include "LaosIO.h"
 
 #define TICKS_PER_MICROSECOND (1) // Ticker uses 1usec units
 // #define CYCLES_PER_ACCELERATION_TICK ((TICKS_PER_MICROSECOND*1000000)/ACCELERATION_TICKS_PER_SECOND)
 #define STEP_TIMER_FREQ 1000000 // 1 MHz
 
 // types: ramp state
-typedef enum {RAMP_UP, RAMP_MAX, RAMP_DOWN} tRamp;
+typedef enum {RAMP_UP, RAMP_MAX, RAMP_DOWN, RAMP_HOLD} tRamp;
 
 // Prototypes
 static void st_interrupt ();
 static void set_step_timer (uint32_t cycles);
+static void update_laser_power (uint32_t cycles);
 static void st_go_idle();
+static void pulse_off();
+static void interlock_check();
 
 // Globals
 volatile unsigned char busy = 0;
@@ -61,10 +65,20 @@ volatile int32_t actpos_x, actpos_y, actpos_z, actpos_e; // actual position
 static block_t *current_block;  // A pointer to the block currently being traced
 static Ticker timer; // the periodic timer used to step
 static Timeout exhaust_timer; // air assist/exhaust turn off delay
-static tFixedPt pwmofs; // the offset of the PWM value
-static tFixedPt pwmscale; // the scaling of the PWM value
+static Timeout pulse_timer; // PPI: ends the laser pulse
+static Ticker interlock_timer; // samples the cover (sys.interlock)
+static uint32_t pwm_min; // PWM match value at zero power [PWM clock ticks]
+static int32_t pwm_range; // change of the PWM match value from zero to full power [PWM clock ticks]
 static volatile int running = 0;  // stepper irq is running
 static uint32_t s_CurrentTimerPeriod = 2000;
+static tFixedPt power_lut[256]; // grayscale bitmap pixel value -> fraction of the block power
+static tFixedPt block_power;    // laser power of the current block (0 .. 1.0)
+static tFixedPt cur_power;      // block power, scaled with the actual speed if laser.modulate is set
+static tFixedPt power_floor;    // minimum fraction of the block power when modulating (0 .. 1.0)
+static tFixedPt power_override = to_fixed(1); // power override, applied to all blocks (1.0: as requested)
+static volatile uint8_t power_changed; // the power override changed: update the current block
+static uint32_t bitmap_mask = 1; // mask for one pixel of a grayscale bitmap
+static int32_t  last_pixel;     // last grayscale pixel value written to the laser
 
 static uint32_t direction_inv;    // invert mask for direction bits
 static uint32_t direction_bits;   // all axes direction (different ports)
@@ -74,6 +88,7 @@ static int32_t counter_x,       // Counter variables for the bresenham line trac
                counter_y,
                counter_z;
 static int32_t counter_e, counter_l, pos_l; // extruder and laser
+static int32_t pulse_dist; // PPI: travel since the last laser pulse [micron, fixed point], -1: fire at next step
 static uint32_t step_events_completed; // The number of step events executed in the current block
 
 // Variables used by the trapezoid generation
@@ -87,6 +102,19 @@ static int32_t   c_min;      // minimal clock cycle count [at vnominal for this
 static int32_t   n;
 static int32_t   decel_n;
 static tRamp     ramp;        // state of state machine for ramping up/down
+static int32_t   ramp_c0;     // clock cycle count of the first step from rest [at n = 0]
+static tFixedPt  c_rest;      // clock cycle count to start from rest
+static volatile tHold hold = HOLD_NONE; // feed hold state
+static uint8_t   start_from_rest; // resumed from a hold: start the next block from rest
+static volatile uint8_t resume_pending, abort_pending; // finished by st_poll() once the hold stopped
+static volatile uint8_t interlock_open; // the cover opened: laser disabled until the next wake up with the cover closed
+static uint32_t  interlock_last;     // time of the last cover sample [usec]
+static volatile uint32_t interlock_interval; // longest time between two cover samples [usec]
+static volatile uint32_t interlock_shutoff;  // longest time from detection to laser off and feed hold [usec]
+static volatile uint32_t endstop_hit; // homing block: step bits of the axes that reached their switch
+static uint32_t  endstop_axes; // homing block: step bits of the axes that move
+static volatile uint32_t status_seq; // snapshot sequence nr: odd while the interrupt updates the snapshot
+static volatile tStStatus status;    // snapshot of the stepper state
 
 extern unsigned char bitmap_bpp;
 extern unsigned long bitmap[], bitmap_width, bitmap_size;
@@ -127,13 +155,16 @@ void st_init(void)
    (cfg->einv ? (1<<E_STEP_BIT) : 0);
 
   printf("Direction: %lu\n", direction_inv);
-  pwmofs = to_fixed(cfg->pwmmin) / 100; // offset (0 .. 1.0)
-  if ( cfg->pwmmin == cfg->pwmmax )
-    pwmscale = 0;
-  else
-    pwmscale = div_f(to_fixed(cfg->pwmmax - cfg->pwmmin), to_fixed(100) );
-  printf("ofs: %lu, scale: %lu\n", pwmofs, pwmscale);
-  actpos_x = actpos_y = actpos_z = actpos_e = 0;
+  // duty cycle in ticks of the PWM period (MR0, set by pwm.period() in LaosMotion)
+  pwm_min = LPC_PWM1->MR0 * cfg->pwmmin / 100;
+  pwm_range = (int32_t)LPC_PWM1->MR0 * (cfg->pwmmax - cfg->pwmmin) / 100;
+  printf("pwm: %lu + %ld / %lu\n", pwm_min, pwm_range, LPC_PWM1->MR0);
+  power_floor = to_fixed(cfg->lmodulatemin) / 100; // (0 .. 1.0)
+  st_set_position(0, 0, 0, 0);
+  interlock_open = 0;
+  interlock_last = interlock_interval = interlock_shutoff = 0;
+  if ( cfg->interlock > 0 )
+    interlock_timer.attach_us(&interlock_check, cfg->interlock);
   st_wake_up();
   trapezoid_tick_cycle_counter = 0;
   st_go_idle();  // Start in the idle state
@@ -170,34 +201,47 @@ static inline void  clear_all_step_pins (void)
   // estep =( (step_inv & (1<<E_STEP_BIT)) ? 0 : 1 );
 }
 
+// write the laser PWM duty cycle [PWM clock ticks]. The match register is shadowed: the
+// new value takes effect at the start of the next PWM period, so a period is never cut short.
+static inline void set_pwm (uint32_t duty)
+{
+  LPC_PWM1->PWM_MATCH = duty;
+  LPC_PWM1->LER |= PWM_LATCH;
+}
 
-// check home sensor
-int hit_home_stop_x(int axis)
+
+// check home sensor (the switch is active when the input equals x.pol)
+static inline int hit_home_stop_x(int axis)
 {
-  return 1;
+  extern GlobalConfig *cfg;
+  return !(xhome ^ cfg->xpol);
 }
 // check home sensor
-int hit_home_stop_y(int axis)
+static inline int hit_home_stop_y(int axis)
 {
-  return 1;
+  extern GlobalConfig *cfg;
+  return !(yhome ^ cfg->ypol);
 }
-// check home sensor
-int hit_home_stop_z(int axis)
+// check home sensor: either the min or the max switch
+static inline int hit_home_stop_z(int axis)
 {
-  return 1;
+  extern GlobalConfig *cfg;
+  return !(zmin ^ cfg->zpol) || !(zmax ^ cfg->zpol);
 }
 
 // Start stepper again from idle state, starts the step timer at a default rate
 void st_wake_up()
 {
   extern GlobalConfig *cfg;
-  if ( ! running )
+  if ( ! running && hold == HOLD_NONE )
   {
     running = 1;
     s_CurrentTimerPeriod = 0; // force an update in set_step_timer
     set_step_timer(2000);
-    laser_enable = cfg->lenable;
-    exhaust = 1; // turn air assist/exhaust on
+    if ( interlock_open && cover )
+      interlock_open = 0; // the cover is closed again
+    laser_enable = ( interlock_open ? !cfg->lenable : cfg->lenable );
+    io->write((1<<IO_EXHAUST)|(1<<IO_AIR), (1<<IO_EXHAUST)|(1<<IO_AIR)); // turn air assist/exhaust on
     exhaust_timer.detach(); // cancel any pending timer
   //  printf("wake_up()..\n");
   }
@@ -210,10 +254,12 @@ static void st_go_idle()
   extern GlobalConfig *cfg;
   timer.detach();
   running = 0;
+  pulse_dist = -1;
   clear_all_step_pins();
   *laser = LASEROFF;
-  pwm = cfg->pwmmax / 100.0;  // set pwm to max;
+  set_pwm(pwm_min + pwm_range);  // set pwm to max;
   laser_enable = !cfg->lenable; // disable the laser
+  io->set(IO_AIR, 0);
   exhaust_timer.attach(&exhaust_off, cfg->exhaust_offdelay);
 	// when job completes turn off air assist/exhaust after
 //  printf("idle()..\n");
@@ -270,9 +316,18 @@ static inline void trapezoid_generator_reset()
 
   c = to_fixed(c);
   c_min = to_fixed (c_min);
+  ramp_c0 = c0;
+  c_rest = to_fixed((tFixedPt)(c0*0.676));
 #undef alpha
 }
 
+// Ramp step index of the speed at clock cycle count "cc": c_n = c0 (sqrt(n+1) - sqrt(n)) ~ c0 / (2 sqrt(n))
+static inline int32_t speed_index (tFixedPt cc)
+{
+  float r = (float)ramp_c0 / (2.0 * max(to_int(cc), 1));
+  return r * r;
+}
+
 
 // get step rate (steps/min) from time cycles
 //static inline uint32_t get_step_rate (uint64_t cycles)
@@ -280,25 +335,77 @@ static inline void trapezoid_generator_reset()
 //  return (TICKS_PER_MICROSECOND*1000000*6) / cycles * 10;
 //}
 
+// Publish the state after this step: a reader retries if status_seq changed (or is odd)
+// while it copied the snapshot
+static inline void publish_status ()
+{
+  status_seq++;
+  status.x = actpos_x;
+  status.y = actpos_y;
+  status.z = actpos_z;
+  status.e = actpos_e;
+  if ( current_block != NULL )
+  {
+    status.block_id = current_block->id;
+    status.step_mm = current_block->step_mm;
+    status.step_us = ( running && current_block->step_mm > 0 ? s_CurrentTimerPeriod : 0 );
+  }
+  else
+  {
+    status.block_id = 0;
+    status.step_mm = 0;
+    status.step_us = 0;
+  }
+  status.laser = ( *laser == LASERON );
+  status_seq++;
+}
+
 // Set the step timer. Note: this starts the ticker at an interval of "cycles"
 static inline void set_step_timer (uint32_t cycles)
 {
    extern GlobalConfig *cfg;
-   volatile static double p;
    if(s_CurrentTimerPeriod != cycles)
    {
      s_CurrentTimerPeriod = cycles;
      timer.attach_us(&st_interrupt,cycles);
-   // p = to_double(pwmofs + mul_f( pwmscale, ((power>>6) * c_min) / ((10000>>6)*cycles) ) );
-   // p = ( to_double(c_min) * current_block->power) / ( 10000.0 * (double)cycles);
-  // p = (60E6/nominal_rate) / cycles; // nom_rate is steps/minute,
-   //printf("%f,%f,%f\n\r", (float)(60E6/nominal_rate), (float)cycles, (float)p);
-  // printf("%d: %f %f\n\r", (int)current_block->power, (float)p, (float)c_min/(float(c) ));
-     p = (double)(cfg->pwmmin/100.0 + ((current_block->power/10000.0)*((cfg->pwmmax - cfg->pwmmin)/100.0)));
-     pwm = p;
+     if ( (cfg->lmodulate || ramp == RAMP_HOLD) && current_block != NULL )
+       update_laser_power(cycles);
    }
 }
 
+// Set the laser power level (0 .. 1.0), scaled between laser.pwm.min and laser.pwm.max
+static inline void set_laser_power (tFixedPt p)
+{
+  if ( p < 0 )
+    p = 0;
+  set_pwm(pwm_min + ((pwm_range * p) >> scale));
+}
+
+// Set the laser power of the current block for a step period of "cycles". With laser.modulate,
+// or during a feed hold, the power is scaled with the actual speed (c_min / cycles), but not
+// below the floor.
+// Grayscale bitmap blocks apply the power at the next pixel.
+static inline void update_laser_power (uint32_t cycles)
+{
+  extern GlobalConfig *cfg;
+  tFixedPt full = mul_f(block_power, power_override);
+  if ( full > to_fixed(1) )
+    full = to_fixed(1);
+  tFixedPt p = full;
+  if ( (cfg->lmodulate || ramp == RAMP_HOLD) && current_block->action_type != AT_WAIT &&
+       cycles > (uint32_t)to_int(c_min) )
+  {
+    p = mul_f(p, c_min / (int32_t)cycles); // c_min is fixed point: the quotient is too
+    if ( p < mul_f(full, power_floor) )
+      p = mul_f(full, power_floor);
+  }
+  cur_power = p;
+  if ( (current_block->options & OPT_BITMAP) && bitmap_bpp > 1 )
+    last_pixel = -1; // force a power update on the next pixel
+  else
+    set_laser_power(p);
+}
+
 // "The Stepper Driver Interrupt" - This timer interrupt is the workhorse of Grbl. It is  executed at the rate set with
 // set_step_timer. It pops blocks from the block_buffer and executes them by pulsing the stepper pins appropriately.
 // It is supported by The Stepper Port Reset Interrupt which it uses to reset the stepper port after each pulse.
@@ -320,20 +427,105 @@ static  void st_interrupt (void)
   // led2 = 1;
   set_step_pins (step_bits ^ step_inv);
 
+  // Feed hold: the last step is done, freeze the rest of the queue
+  if ( hold == HOLD_STOPPING )
+  {
+    timer.detach();
+    running = 0;
+    step_bits = 0;
+    *laser = LASEROFF;
+    hold = HOLD_STOPPED;
+    clear_all_step_pins ();
+    publish_status();
+    busy = 0;
+    return;
+  }
+
+  // A dwell ends at the first interrupt after it started
+  if (current_block != NULL && current_block->action_type == AT_WAIT)
+  {
+    current_block = NULL;
+    plan_discard_current_block();
+    *laser = LASEROFF;
+    if ( hold != HOLD_NONE )
+    {
+      // we are at rest: stop here
+      timer.detach();
+      running = 0;
+      start_from_rest = 1;
+      hold = HOLD_STOPPED;
+      clear_all_step_pins ();
+      publish_status();
+      busy = 0;
+      return;
+    }
+  }
+
   // If there is no current block, attempt to pop one from the buffer
   if (current_block == NULL)
   {
     // Anything in the buffer?
     current_block = plan_get_current_block();
-    if (current_block != NULL) {
+    // the cover opened since the last wake up (and may be closed again): hold at the next
+    // block that fires the laser, until the job is resumed. This block is normally held at
+    // the end of the previous one (see below); only if the cover opened within the stopping
+    // distance, the hold ends in this block.
+    if ( current_block != NULL && interlock_open && hold == HOLD_NONE &&
+         ( current_block->options & (OPT_LASER_ON | OPT_BITMAP) ) )
+      st_feed_hold();
+    if ( current_block != NULL && current_block->action_type == AT_WAIT && hold != HOLD_NONE )
+    {
+      // a dwell starts at rest: stop before it, it runs after the resume
+      current_block = NULL;
+      timer.detach();
+      running = 0;
+      start_from_rest = 1;
+      hold = HOLD_STOPPED;
+      clear_all_step_pins ();
+      publish_status();
+      busy = 0;
+      return;
+    }
+    // auxiliary outputs (air assist, exhaust) switch in step with the motion
+    if (current_block != NULL && current_block->aux_mask)
+      io->write(current_block->aux_mask, current_block->aux_value);
+    if (current_block != NULL && current_block->action_type == AT_WAIT) {
+      // dwell: the next interrupt is after dwell_us, the laser is on (at the block power) or off
+      step_bits = 0;
+      pulse_dist = -1;
+      block_power = to_fixed((int32_t)current_block->power) / 10000;
+      set_step_timer(current_block->dwell_us ? current_block->dwell_us : 1);
+      update_laser_power(0);
+    }
+    else if (current_block != NULL) {
+      tFixedPt c_prev = c;
       trapezoid_generator_reset();
+      if ( hold == HOLD_DECEL )
+      {
+        // keep slowing down from the speed at the end of the previous block
+        c = c_prev;
+        ramp = RAMP_HOLD;
+        n = -speed_index(c);
+      }
+      else if ( start_from_rest )
+      {
+        c = c_rest;
+        n = 1;
+      }
+      start_from_rest = 0;
       counter_x = -(current_block->step_event_count >> 1);
       counter_y = counter_x;
       counter_z = counter_x;
       counter_e = counter_x;
       counter_l = counter_x;
-      pos_l = 0; // reset laser bitmap counter
+      pos_l = current_block->bitmap_ofs; // reset laser bitmap counter
+      block_power = to_fixed((int32_t)current_block->power) / 10000;
+      update_laser_power(to_int(c));
       step_events_completed = 0;
+      endstop_hit = 0;
+      endstop_axes = (current_block->steps_x ? (1<<X_STEP_BIT) : 0) |
+                     (current_block->steps_y ? (1<<Y_STEP_BIT) : 0) |
+                     (current_block->steps_z ? (1<<Z_STEP_BIT) : 0);
       direction_bits = current_block->direction_bits ^ direction_inv;
       set_direction_pins ();
       step_bits = 0;
@@ -341,51 +533,110 @@ static  void st_interrupt (void)
     else
     {
       st_go_idle();
+      if ( hold != HOLD_NONE )
+        hold = HOLD_STOPPED;
     }
   }
 
   // process the current block
   if (current_block != NULL)
   {
+   if ( power_changed )
+   {
+     power_changed = 0;
+     update_laser_power(to_int(c));
+   }
 
    // this block is a bitmap engraving line, read laser on/off status from buffer
    if ( current_block->options & OPT_BITMAP )
    {
-      *laser =  ! (bitmap[pos_l / 32] & (1 << (pos_l % 32)));
-      counter_l += bitmap_width;
-     //  printf("%d %d %d: %d %d %c\n\r", bitmap_width, pos_l, counter_l,  pos_l / 32, pos_l % 32, (*laser ?  '1' : '0' ));
+      if ( bitmap_bpp == 1 )
+        *laser = ( (bitmap[pos_l / 32] & (1 << (pos_l % 32))) && !interlock_open ? LASERON : LASEROFF );
+      else
+      {
+        // grayscale: set the power of each pixel from the LUT
+        uint32_t bit = pos_l * bitmap_bpp;
+        int32_t pixel = (bitmap[bit / 32] >> (bit % 32)) & bitmap_mask;
+        if ( pixel != last_pixel )
+        {
+          last_pixel = pixel;
+          set_laser_power(mul_f(power_lut[pixel], cur_power));
+          *laser = ( pixel && !interlock_open ? LASERON : LASEROFF );
+        }
+      }
+      counter_l += current_block->bitmap_len;
+     //  printf("%d %d %d: %d %d %c\n\r", current_block->bitmap_len, pos_l, counter_l,  pos_l / 32, pos_l % 32, (*laser ?  '1' : '0' ));
       if (counter_l > 0)
       {
         counter_l -= current_block->step_event_count;
      //   putchar ( (*laser ?  '1' : '0' ) );
-        pos_l++;
+        if ( current_block->options & OPT_BITMAP_REV )
+          pos_l--;
+        else
+          pos_l++;
       }
    }
+   else if ( current_block->pulse_step )
+   {
+     // pulses per distance: fire a pulse every pulse_spacing of travel, the phase carries over
+     // to the next block
+     if ( pulse_dist < 0 )
+       pulse_dist = current_block->pulse_spacing;
+     else
+       pulse_dist += current_block->pulse_step;
+     if ( pulse_dist >= current_block->pulse_spacing )
+     {
+       pulse_dist %= current_block->pulse_spacing;
+       if ( !interlock_open )
+         *laser = LASERON;
+       pulse_timer.attach_us(&pulse_off, current_block->pulse_width);
+     }
+   }
    else
    {
-     *laser = ( current_block->options & OPT_LASER_ON ? LASERON : LASEROFF);
+     *laser = ( (current_block->options & OPT_LASER_ON) && !interlock_open ? LASERON : LASEROFF);
+     pulse_dist = -1;
    }
 
     if (current_block->action_type == AT_MOVE)
     {
+      // Homing block: every axis stops at its own switch
+      uint32_t stop_bits = 0;
+      if (current_block->check_endstops)
+      {
+        if ( current_block->steps_x && hit_home_stop_x (direction_bits & (1<<X_DIRECTION_BIT)) )
+          endstop_hit |= (1<<X_STEP_BIT);
+        if ( current_block->steps_y && hit_home_stop_y (direction_bits & (1<<Y_DIRECTION_BIT)) )
+          endstop_hit |= (1<<Y_STEP_BIT);
+        if ( current_block->steps_z && hit_home_stop_z (direction_bits & (1<<Z_DIRECTION_BIT)) )
+          endstop_hit |= (1<<Z_STEP_BIT);
+        stop_bits = endstop_hit;
+      }
+
       // Execute step displacement profile by bresenham line algorithm
       step_bits = 0;
       counter_x += current_block->steps_x;
       if (counter_x > 0) {
-        actpos_x +=  ( (current_block->direction_bits & (1<<X_DIRECTION_BIT))? -1 : 1 );
-        step_bits |= (1<<X_STEP_BIT);
+        if ( !(stop_bits & (1<<X_STEP_BIT)) ) {
+          actpos_x +=  ( (current_block->direction_bits & (1<<X_DIRECTION_BIT))? -1 : 1 );
+          step_bits |= (1<<X_STEP_BIT);
+        }
         counter_x -= current_block->step_event_count;
       }
       counter_y += current_block->steps_y;
       if (counter_y > 0) {
-        actpos_y +=  ( (current_block->direction_bits & (1<<Y_DIRECTION_BIT))? -1 : 1 );
-        step_bits |= (1<<Y_STEP_BIT);
+        if ( !(stop_bits & (1<<Y_STEP_BIT)) ) {
+          actpos_y +=  ( (current_block->direction_bits & (1<<Y_DIRECTION_BIT))? -1 : 1 );
+          step_bits |= (1<<Y_STEP_BIT);
+        }
         counter_y -= current_block->step_event_count;
       }
       counter_z += current_block->steps_z;
       if (counter_z > 0) {
-        actpos_z +=  ( (current_block->direction_bits & (1<<Z_DIRECTION_BIT))? -1 : 1 );
+        if ( !(stop_bits & (1<<Z_STEP_BIT)) ) {
+          actpos_z +=  ( (current_block->direction_bits & (1<<Z_DIRECTION_BIT))? -1 : 1 );
           step_bits |= (1<<Z_STEP_BIT);
+        }
         counter_z -= current_block->step_event_count;
       }
 
@@ -402,16 +653,10 @@ static  void st_interrupt (void)
       step_events_completed++; // Iterate step events
 
       // This is a homing block, keep moving until all end-stops are triggered
-      if (current_block->check_endstops)
+      if ( current_block->check_endstops && endstop_hit == endstop_axes )
       {
-        if ( (current_block->steps_x && hit_home_stop_x (direction_bits & (1<<X_DIRECTION_BIT)) ) ||
-             (current_block->steps_y && hit_home_stop_y (direction_bits & (1<<Y_DIRECTION_BIT)) ) ||
-             (current_block->steps_z && hit_home_stop_z (direction_bits & (1<<Z_DIRECTION_BIT)) )
-           )
-        {
-          step_events_completed = current_block->step_event_count;
-          step_bits = 0;
-        }
+        step_events_completed = current_block->step_event_count;
+        step_bits = 0;
       }
 
 
@@ -420,6 +665,24 @@ static  void st_interrupt (void)
       {
         tFixedPt new_c;
 
+        // The cover opened: if the next block fires the laser, stop at the end of this one, so
+        // the laser block is cut completely after the resume
+        if ( interlock_open && hold == HOLD_NONE &&
+             !( current_block->options & (OPT_LASER_ON | OPT_BITMAP) ) &&
+             current_block->step_event_count - step_events_completed <= (uint32_t)speed_index(c) + 1 )
+        {
+          block_t *next = plan_get_next_block();
+          if ( next != NULL && ( next->options & (OPT_LASER_ON | OPT_BITMAP) ) )
+            st_feed_hold();
+        }
+
+        // Feed hold: decelerate from the actual speed, along the path
+        if ( hold == HOLD_DECEL && ramp != RAMP_HOLD )
+        {
+          ramp = RAMP_HOLD;
+          n = -speed_index(c);
+        }
+
         switch (ramp)
         {
           case RAMP_UP:
@@ -428,7 +691,7 @@ static  void st_interrupt (void)
             if (step_events_completed >= current_block->decelerate_after)
             {
               ramp = RAMP_DOWN;
-              n = decel_n;
+              n = max(decel_n, -n); // after a hold we may be slower than planned
             }
             else if (new_c <= c_min)
             {
@@ -450,9 +713,23 @@ static  void st_interrupt (void)
           break;
 
           case RAMP_DOWN:
-            new_c = c - (c<<1) / (4*n+1);
-            set_step_timer (to_int(new_c));
-            c = new_c;
+            if ( n < -1 ) // keep the lowest speed when resumed close to the end of the block
+            {
+              new_c = c - (c<<1) / (4*n+1);
+              set_step_timer (to_int(new_c));
+              c = new_c;
+            }
+          break;
+
+          case RAMP_HOLD:
+            if ( n < -1 )
+            {
+              new_c = c - (c<<1) / (4*n+1);
+              set_step_timer (to_int(new_c));
+              c = new_c;
+            }
+            else
+              hold = HOLD_STOPPING; // stop after this step
           break;
         }
 
@@ -472,20 +749,210 @@ static  void st_interrupt (void)
   }
 
   clear_all_step_pins (); // clear the pins, assume that we spend enough CPU cycles in the previous statements for the steppers to react (>1usec)
+  publish_status();
   busy=0;
 
 }
 
 
+// Prepare for bitmap lines with bpp bits per pixel (1, 2, 4 or 8): fill the power lookup
+// table with the fraction of the block power for every pixel value.
+// Only call this when no bitmap block is being executed.
+void st_set_bitmap_bpp(int bpp)
+{
+  int i;
+  if ( bpp < 1 || bpp > 8 )
+    bpp = 1;
+  bitmap_mask = (1 << bpp) - 1;
+  for (i=0; i <= (int)bitmap_mask; i++)
+    power_lut[i] = to_fixed(i) / (int)bitmap_mask;
+}
+
+// Copy the last snapshot published by the stepper interrupt. The interrupt never waits for
+// this: if it published a new snapshot during the copy, copy again.
+void st_get_status(tStStatus *s)
+{
+  uint32_t seq;
+  do
+  {
+    seq = status_seq;
+    s->x = status.x;
+    s->y = status.y;
+    s->z = status.z;
+    s->e = status.e;
+    s->block_id = status.block_id;
+    s->step_us = status.step_us;
+    s->step_mm = status.step_mm;
+    s->laser = status.laser;
+  } while ( (seq & 1) || seq != status_seq );
+}
+
+// Set the actual position [steps] and publish it. Only call this when the steppers do not move.
+void st_set_position(int32_t x, int32_t y, int32_t z, int32_t e)
+{
+  __disable_irq();
+  actpos_x = x;
+  actpos_y = y;
+  actpos_z = z;
+  actpos_e = e;
+  publish_status();
+  __enable_irq();
+}
+
+// Actual speed of a snapshot [mm/min]
+float st_status_speed(const tStStatus *s)
+{
+  if ( s->step_us == 0 )
+    return 0;
+  return s->step_mm * (60.0 * STEP_TIMER_FREQ) / s->step_us;
+}
+
+// Feed hold: decelerate to a stop along the path, at the acceleration of the blocks. The laser
+// power follows the speed while slowing down, and the laser is off when stopped.
+void st_feed_hold()
+{
+  resume_pending = 0; // a new hold cancels a resume that waits for the stop
+  if ( hold != HOLD_NONE )
+    return;
+  hold = ( running ? HOLD_DECEL : HOLD_STOPPED );
+}
+
+// Resume after a feed hold: continue the path from rest. If the hold is still slowing down
+// (or in a dwell), this does not wait: st_poll() continues once stopped.
+// Returns 0 (and stays on hold) if the interlock tripped and the cover is still open.
+int st_resume()
+{
+  if ( hold == HOLD_NONE )
+    return 1;
+  if ( interlock_open && !cover )
+    return 0;
+  if ( !abort_pending )
+    resume_pending = 1;
+  st_poll();
+  return 1;
+}
+
+// Continue a stopped feed hold
+static void resume_stopped()
+{
+  if ( current_block != NULL )
+  {
+    c = c_rest;
+    n = 1;
+    ramp = RAMP_UP;
+  }
+  else
+    start_from_rest = 1;
+  hold = HOLD_NONE;
+  if ( current_block != NULL || !plan_queue_empty() )
+    st_wake_up();
+}
+
+// Return the step bits of the axes that reached their switch in the last homing block
+uint32_t st_endstops_hit()
+{
+  return endstop_hit;
+}
+
+// Return the feed hold state
+tHold st_hold_state()
+{
+  return hold;
+}
+
+// Abort: stop within one deceleration distance, and discard the queue. This does not wait for
+// the stop: st_poll() discards the queue once stopped. Returns 1 if that is already done.
+int st_abort()
+{
+  st_feed_hold();
+  abort_pending = 1;
+  return st_poll();
+}
+
+// Finish a pending resume or abort once the feed hold has stopped. Call this from the main
+// loop. Returns 1 if nothing is pending (any more).
+int st_poll()
+{
+  if ( !resume_pending && !abort_pending )
+    return 1;
+  if ( hold != HOLD_STOPPED )
+    return 0; // still slowing down
+  if ( abort_pending )
+  {
+    current_block = NULL;
+    plan_flush();
+    start_from_rest = 0;
+    hold = HOLD_NONE;
+    st_go_idle();
+  }
+  else if ( !interlock_open || cover )
+    resume_stopped();
+  resume_pending = abort_pending = 0; // a resume with the cover opened again stays on hold
+  return 1;
+}
+
+// Set the power override [%] of all blocks, including the current one
+void st_set_power_override(int percent)
+{
+  power_override = to_fixed(percent) / 100;
+  power_changed = 1;
+}
+
 // Block until all buffered steps are executed
 void st_synchronize()
 {
   while(plan_get_current_block()) { sleep_mode(); }
 }
 
+// Interlock (sys.interlock): sample the cover. If it is open, the laser is switched off and
+// disabled, and a feed hold starts if the current block fires the laser (otherwise
+// st_interrupt() stops before the next block that does, even if the cover closed). The worst case
+// reaction time is the longest interval between two samples (this interrupt shares the
+// timer with the stepper interrupt) plus the time to shut off.
+static void interlock_check()
+{
+  uint32_t t0 = us_ticker_read();
+  if ( interlock_last && t0 - interlock_last > interlock_interval )
+    interlock_interval = t0 - interlock_last;
+  interlock_last = t0;
+  if ( cover )
+    return;
+  extern GlobalConfig *cfg;
+  *laser = LASEROFF;
+  laser_enable = !cfg->lenable;
+  if ( current_block != NULL && hold == HOLD_NONE &&
+       ( current_block->options & (OPT_LASER_ON | OPT_BITMAP) ) )
+    st_feed_hold();
+  if ( !interlock_open )
+  {
+    interlock_open = 1;
+    uint32_t dt = us_ticker_read() - t0;
+    if ( dt > interlock_shutoff )
+      interlock_shutoff = dt;
+  }
+}
+
+// Interlock state: 1 if the cover opened, and the laser is disabled
+int st_interlock_open()
+{
+  return interlock_open;
+}
+
+// Worst case interlock reaction time measured so far [usec]
+uint32_t st_interlock_latency()
+{
+  return interlock_interval + interlock_shutoff;
+}
+
+// PPI: end of a laser pulse
+static void pulse_off()
+{
+  *laser = LASEROFF;
+}
+
 void exhaust_off()
 {
-    exhaust = 0;
+    io->set(IO_EXHAUST, 0);
     exhaust_timer.detach();
 }
 
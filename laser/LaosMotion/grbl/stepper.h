@@ -111,6 +111,42 @@ void st_go_home();
 // to notify the subsystem that it is time to go to work.
 void st_wake_up();
 
+// Set the nr of bits per pixel for the following bitmap lines, and fill the power table
+void st_set_bitmap_bpp(int bpp);
+
+// Set the power override [%] of all blocks, including the current one
+void st_set_power_override(int percent);
+
+// Step bits (1<<X_STEP_BIT etc.) of the axes that reached their home switch in the last
+// AT_MOVE_ENDSTOP block. Every axis stops at its own switch; the block ends when all are there.
+uint32_t st_endstops_hit();
+
+// Feed hold
+typedef enum {HOLD_NONE, HOLD_DECEL, HOLD_STOPPING, HOLD_STOPPED} tHold;
+void st_feed_hold(); // decelerate to a stop along the path and freeze the queue
+int st_resume(); // continue after a feed hold (once stopped, see st_poll), returns 0 if the interlock is still open
+tHold st_hold_state();
+int st_abort(); // stop within one deceleration distance and discard the queue (once stopped), returns 1 if done
+int st_poll(); // finish a pending resume or abort when stopped, call from the main loop; returns 1 if none is pending
+
+// Snapshot of the stepper state, published by the stepper interrupt after every step.
+// All fields belong to the same moment.
+typedef struct {
+  int32_t x, y, z, e;   // actual position [steps]
+  uint32_t block_id;    // id of the block being executed, 0: none
+  uint32_t step_us;     // period of the current step event [usec], 0: at rest
+  float step_mm;        // travel per step event of the current block [mm]
+  uint8_t laser;        // the laser output is on
+} tStStatus;
+void st_get_status(tStStatus *status); // safe to call from any context, does not block the stepper
+float st_status_speed(const tStStatus *status); // actual speed of a snapshot [mm/min]
+void st_set_position(int32_t x, int32_t y, int32_t z, int32_t e); // set the actual position [steps], only when at rest
+
+// Interlock (sys.interlock): the cover is sampled from a timer interrupt. When it opens, the
+// laser is switched off and a feed hold starts within one sample period.
+int st_interlock_open(); // the cover opened: the laser is disabled
+uint32_t st_interlock_latency(); // worst case reaction time measured so far [usec]
+
 // leave exhaust running after job completes.
 void exhaust_off();
 
@@ -30,8 +30,9 @@ extern DigitalIn zmax;
 
 // Laser IO
 extern PwmOut pwm;              // O1: PWM (Yellow)
+#define PWM_MATCH MR5           // match register of the PWM pin (p22 = PWM1.5),
+#define PWM_LATCH (1 << 5)      // and its bit in the latch enable register
 extern DigitalOut laser_enable; // O2: enable laser
-extern DigitalOut exhaust;      // 03: NC
 extern DigitalOut *laser;       // O4: LaserON (White), do not statically
                                 //     allocate: because this will cause the
                                 //     laser to switch on at boot
@@ -72,6 +72,8 @@ GlobalConfig::GlobalConfig(const std::string &filename) {
   cfg.Value("sys.i2cbaud", &i2cbaud, 9600);
   cfg.Value("sys.cleandir", &cleandir, 1);
   cfg.Value("sys.disablecancelcheck", &disablecancelcheck, 0);
+  cfg.Value("sys.interlock", &interlock, 1000);  // cover interlock sample period [usec], 0: off
+  cfg.Value("sys.debounce", &debounce, 5);    // debounce time of the inputs [msec]
 
   // Laser
   cfg.Value("laser.enable", &lenable, 1);        // laser enable polarity [0/1]
@@ -79,6 +81,8 @@ GlobalConfig::GlobalConfig(const std::string &filename) {
   cfg.Value("laser.pwm.min", &pwmmin, 0);        // pwm at minimum power [0..100]
   cfg.Value("laser.pwm.max", &pwmmax, 0);        // pwm at maximum power [0..100]
   cfg.Value("laser.pwm.freq", &pwmfreq, 20000);  // pwm frequency [Hz]
+  cfg.Value("laser.modulate", &lmodulate, 0);    // scale power with the actual speed [0/1]
+  cfg.Value("laser.modulate.min", &lmodulatemin, 20);  // power floor when modulating [% of set power]
   cfg.Value("sys.exhaustoffdelay", &exhaust_offdelay, 30);
   // how long to continue air assist/extract after job completion (secs)
 
@@ -122,6 +126,12 @@ GlobalConfig::GlobalConfig(const std::string &filename) {
   cfg.Value("z.accel", &zaccel, 2000);
   cfg.Value("e.accel", &eaccel, 2000);
 
+  // ramp time quantisation: ringing frequency [Hz] (0=off) and damping ratio [%]
+  cfg.Value("x.ramp.freq", &xrampfreq, 0);
+  cfg.Value("y.ramp.freq", &yrampfreq, 0);
+  cfg.Value("x.ramp.damping", &xrampdamping, 10);
+  cfg.Value("y.ramp.damping", &yrampdamping, 10);
+
   // max axis speed [mm/sec]
   // home positions [um]
   cfg.Value("x.home", &xhome, 0);
@@ -142,10 +152,27 @@ GlobalConfig::GlobalConfig(const std::string &filename) {
   // motion settings: enable output state
   cfg.Value("motion.homespeed", &homespeed, 10);    // speed during homing [usec/step]
   cfg.Value("motion.zhomespeed", &zhomespeed, 10);  // z-axis speed during homing [usec/step]
+  cfg.Value("motion.homefast", &homefast, 50);      // fast approach to the home switches [mm/sec], 0: slow only
+  cfg.Value("motion.homebackoff", &homebackoff, 2000);  // back-off before the slow approach [micrometer]
+  cfg.Value("motion.zhomeconcurrent", &zhomeconcurrent, 0);  // home z together with x and y [0/1]
   cfg.Value("motion.speed", &speed, 100);           // max speed [mm/sec]
   cfg.Value("motion.accel", &accel, 100);           // accelleration [mm/sec2]
   cfg.Value("motion.enable", &enable, 0);           // enable output polarity [0/1]
+  cfg.Value("motion.rapidspeed", &rapidspeed, speed);  // speed of laser-off moves [mm/sec]
+  cfg.Value("motion.rapidaccel", &rapidaccel, accel);  // acceleration of laser-off moves [mm/sec2]
   cfg.Value("motion.tolerance", &tolerance, 50);    // cornering tolerance [1/1000 units]
+  cfg.Value("motion.tolerance.move", &movetolerance, tolerance);      // cornering tolerance of laser-off moves
+  cfg.Value("motion.tolerance.raster", &rastertolerance, tolerance);  // cornering tolerance of bitmap lines
+  cfg.Value("motion.merge", &mergetol, 10);         // merge collinear and short segments within [um], 0=off
+  cfg.Value("motion.blend", &blendtol, 0);          // round corners of laser lines within [um], 0=off
+  cfg.Value("motion.buffer", &buffertime, 2000);    // max. motion to buffer ahead [msec], 0=fill the queue
+  cfg.Value("motion.underrun", &underrun, 200);     // buffered motion is low below [msec], 0=off
+  cfg.Value("motion.underrun.feed", &underrunfeed, 100);  // min. feed when the buffer is low [%], 100=no scaling
+
+  // raster engraving
+  cfg.Value("raster.skip", &rasterskip, 2000);  // blank run length to skip at travel speed [um], 0=off
+  cfg.Value("raster.bidir", &rasterbidir, 0);   // 1: engrave lines in both directions, with overscan
+  cfg.Value("raster.lead", &rasterlead, 0);     // laser on/off lead time [usec]
 
   cfg.Value("dir_us", &dir_us, 0);
   cfg.Value("pulse_us", &pulse_us, 0);
@@ -48,6 +48,8 @@ class GlobalConfig {
   int cleandir;                    // remove files from SD at startup
   int i2cbaud;                     // i2cBaudrate
   int disablecancelcheck;          // if the check for cancel button should be disabled while a job is running
+  int interlock;                   // cover interlock sample period [usec], 0: off
+  int debounce;                    // debounce time of the inputs [msec]
   int xmax, ymax, zmax, emax;      // max values
   int xmin, ymin, zmin, emin;      // min values
   int xpol, ypol, zpol, epol;      // polarity for the home switches
@@ -56,18 +58,32 @@ class GlobalConfig {
   int xrest, yrest, zrest, erest;  // rest positon (moveto after job)
   int xhomedir, yhomedir, zhomedir, ehomedir;
   int homespeed, zhomespeed;                  // speed used for homing [usec/step]
+  int homefast, homebackoff;                  // fast approach speed [mm/sec] (0=off) and back-off [micrometer]
+  int zhomeconcurrent;                        // home z together with x and y
   int speed, xspeed, yspeed, zspeed, espeed;  // Maximum linear speed and max speed per axis [mm/sec]
   int accel;                                  // defaul accelletaion [mm/sec2]
   int xaccel, yaccel, zaccel, eaccel;         // axis max acceleration [mm/sec2]
+  int xrampfreq, yrampfreq;                   // ringing frequency of the axis [Hz], 0=no ramp time quantisation
+  int xrampdamping, yrampdamping;             // damping ratio of the ringing [%]
+  int rapidspeed, rapidaccel;                 // speed [mm/sec] and acceleration [mm/sec2] of laser-off moves
   int tolerance;                              // corner tolerance [micrometer]
+  int movetolerance, rastertolerance;         // corner tolerance of laser-off moves and bitmap lines [micrometer]
+  int mergetol;                               // tolerance for merging segments [micrometer]
+  int blendtol;                               // tolerance for blending corners of laser lines [micrometer]
+  int buffertime;                             // max. motion time to buffer ahead [msec]
+  int underrun, underrunfeed;                 // low buffer threshold [msec] and min. feed when low [%]
   int xscale;                                 // steps per meter
   int yscale;                                 // steps per meter
   int zscale;                                 // steps per meter
   int escale;                                 // steps per meter
   int lenable, lon, pwmmin, pwmmax, pwmfreq;  // laser enable, laser on and pwm min/max [%] and frequency [Hz];
+  int lmodulate, lmodulatemin;                // scale power with speed [0/1], min. power when scaling [%]
   int exhaust, exhaust_offdelay;              // How long to continue powering air
   int dir_us, pulse_us;                       // extra wait time for longer pulse/dir
                                               // nozzle/exhaust after job has ended (seconds).
+  int rasterskip;                             // min. blank raster run traversed at travel speed [micrometer]
+  int rasterbidir;                            // engrave bitmap lines in both directions (0/1)
+  int rasterlead;                             // laser response time, traced ahead of the pixels [usec]
 };
 
 #ifndef __GIT_HASH
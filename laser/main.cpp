@@ -52,6 +52,7 @@
 #include "TFTPServer.h"
 #include "LaosMenu.h"
 #include "LaosMotion.h"
+#include "LaosIO.h"
 #include "SDFileSystem.h"
 #include "laosfilesystem.h"
 
@@ -67,6 +68,7 @@ LaosDisplay *dsp;
 LaosMenu *mnu;
 TFTPServer *srv;
 LaosMotion *mot;
+LaosIO *io;
 Timer systime;
 
 // Config
@@ -74,6 +76,7 @@ GlobalConfig *cfg;
 
 // Protos
 void main_nodisplay();
+void wait_ready_nodisplay();
 void main_menu();
 
 // for debugging:
@@ -124,6 +127,7 @@ int main()
     dsp->testI2C();
 
   printf("MOTION...\n");
+  io = new LaosIO();
   mot = new LaosMotion();
 
   eth = EthConfig();
@@ -138,24 +142,12 @@ int main()
 
   printf("RUN...\n");
 
-  // Wait for key, and then home
+  // Start homing: it waits for the cover, and is moved on from the main loop
 
   if ( cfg->autohome )
   {
-    printf("WAIT FOR COVER...\n");
-    wait(1);
-
-
-  // Start homing
-    mnu->SetScreen("WAIT FOR COVER....");
-    //if ( cfg->waitforstart )
-      while ( !mot->isStart() );
-    mnu->SetScreen("HOME....");
     printf("HOME...\n");
-
-    mot->home(cfg->xhome,cfg->yhome, cfg->zhome);
-    // if ( !mot->isHome ) exit(1);
-    printf("HOME DONE. (%d,%d, %d)\n",cfg->xhome,cfg->yhome,cfg->zhome);
+    mot->startHoming(cfg->xhome,cfg->yhome, cfg->zhome);
   }
   else
     printf("Homing skipped: %d\n", cfg->autohome);
@@ -182,13 +174,22 @@ void main_nodisplay() {
   {
     int filecnt = srv->fileCnt();
     mnu->SetScreen("Wait for file ...");
-    while (srv->State() == listen)
+    while (srv->State() == listen) {
         srv->poll();
+        mot->poll();
+    }
     if (srv->State() != listen) {
       mnu->SetScreen("Receive file");
-      while ((! mnu->Cancel()) && (srv->State() != listen)) srv->poll();
+      while ((! mnu->Cancel()) && (srv->State() != listen)) {
+        srv->poll();
+        mot->poll();
+      }
     }
     if (filecnt < srv->fileCnt()) {
+      while (mot->isHoming()) {
+        srv->poll();
+        mot->poll();
+      }
       mot->reset();
       plan_get_current_position_xyz(&x, &y, &z);
        printf("%f %f\n", x,y);
@@ -200,19 +201,40 @@ void main_nodisplay() {
        FILE *in = sd.openfile(name, "r");
        while (!feof(in))
        {
-         while (!mot->ready() );
+         wait_ready_nodisplay();
          mot->write(readint(in));
        }
+       mot->endJob();
        fclose(in);
        removefile(name);
        // done
-       printf("DONE!...\n");
-	   while (!mot->ready() );
+       printf("DONE!... (underruns: %d, low buffer: %d, interlock: %d usec)\n", mot->underruns(), mot->lowBuffers(),
+         mot->interlockLatency());
+       wait_ready_nodisplay();
        mot->moveToAbsolute(cfg->xrest, cfg->yrest, cfg->zrest);
     }
   }
 }
 
+/**
+*** Wait until the motion is ready for more work. If the cover opened, the job is held:
+*** continue when the cover is closed again and ok is pressed
+**/
+void wait_ready_nodisplay() {
+  bool held = false;
+  while (!mot->ready()) {
+    if (mot->isHeld() && !held) {
+      held = true;
+      printf("Job held: close the cover and press ok\n\r");
+      mnu->SetScreen("COVER OPEN, OK?");
+    }
+    if (held && mot->isStart() && mnu->Ok() && mot->resume()) {
+      held = false;
+      mnu->SetScreen("Laser BUSY...");
+    }
+  }
+}
+
 void main_menu() {
   // main loop
   led1=led2=led3=led4=0;
@@ -222,9 +244,13 @@ void main_menu() {
     int filecnt = srv->fileCnt();
     mnu->Handle();
     srv->poll();
+    mot->poll();
     if (srv->State() != listen) {
       mnu->SetScreen("Receive file");
-	  while ((! mnu->Cancel()) && (srv->State() != listen)) srv->poll();
+	  while ((! mnu->Cancel()) && (srv->State() != listen)) {
+        srv->poll();
+        mot->poll();
+      }
     }
     if (filecnt < srv->fileCnt()) {
       char myname[32];